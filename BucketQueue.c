@@ -0,0 +1,377 @@
+#include "BucketQueue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+				/** Bucket Queue and Multi-Level Feedback Scheduler **/
+/** One FIFO ring buffer per priority level, and a two-level bitmap of which levels are non-empty. **/
+/** The highest (or lowest) non-empty level is found with two find-first-set instructions, so offer and poll are O(1), **/
+/** no matter how many elements are queued. Use it instead of PrioQueue when priorities are small bounded integers. **/
+
+#define BQUEUE_INITIAL_RING 8
+
+typedef struct
+{
+	int value;		//each element has a value, and the ticks it has used on its current level,
+	int used;		//which the scheduler uses to decide when to demote it
+} b_elem;
+
+typedef struct
+{
+	b_elem *items;		//ring buffer of the level's elements in FIFO order
+	unsigned int head;	//index of the oldest element
+	unsigned int count;	//how many elements the level holds
+	unsigned int capacity;	//always a power of two, so wrapping around is a mask
+} ring;
+
+struct BucketQueue
+{
+	int levels;		//priorities run from 0 to levels-1
+	int size;		//how many elements are in the queue
+	uint64_t summary;	//bit w is set when bits[w] has any bit set
+	uint64_t bits[BQUEUE_MAX_LEVELS / 64];	//bit l%64 of bits[l/64] is set when level l is non-empty
+	ring *level;
+	int *quantum;		//ticks a job may use on each level before it is demoted one level
+	int boost_period;	//ticks between boosting every job back to the top level, 0 to never boost
+	int clock;		//ticks since the last boost
+};
+
+/** Make room for one more element on a ring **/
+static int ring_grow(ring *r)
+{
+	unsigned int capacity = r->capacity ? r->capacity * 2 : BQUEUE_INITIAL_RING;
+
+	b_elem *items = (b_elem*)malloc(capacity * sizeof(b_elem));
+	if(items == NULL) {
+		printf("Could not grow queue.\n");
+		return -1;
+	}
+
+	//unwrap the old contents to the start of the new buffer
+	for(unsigned int i = 0; i < r->count; i++)
+		items[i] = r->items[(r->head + i) & (r->capacity - 1)];
+
+	free(r->items);
+	r->items = items;
+	r->head = 0;
+	r->capacity = capacity;
+	return 0;
+}
+
+static void mark_full(BucketQueue *queue, int level)
+{
+	queue->bits[level / 64] |= (uint64_t)1 << (level % 64);
+	queue->summary |= (uint64_t)1 << (level / 64);
+}
+
+static void mark_empty(BucketQueue *queue, int level)
+{
+	queue->bits[level / 64] &= ~((uint64_t)1 << (level % 64));
+	if(queue->bits[level / 64] == 0)
+		queue->summary &= ~((uint64_t)1 << (level / 64));
+}
+
+/** Append an element to the back of a level **/
+static int push(BucketQueue *queue, int level, b_elem e)
+{
+	ring *r = &queue->level[level];
+
+	if(r->count == r->capacity && ring_grow(r) != 0)
+		return -1;
+
+	r->items[(r->head + r->count) & (r->capacity - 1)] = e;
+	if(r->count++ == 0)
+		mark_full(queue, level);
+
+	queue->size++;		//reflect addition of new element
+	return 0;
+}
+
+/** Put e back at the front of its level, where pop(queue, level, 0) just took it from; there is always room for it **/
+static void unpop(BucketQueue *queue, int level, b_elem e)
+{
+	ring *r = &queue->level[level];
+
+	r->head = (r->head - 1) & (r->capacity - 1);
+	r->items[r->head] = e;
+	if(r->count++ == 0)
+		mark_full(queue, level);
+
+	queue->size++;		//reflect addition of element
+}
+
+/** Take the element from the front (oldest) or back (newest) of a non-empty level **/
+static b_elem pop(BucketQueue *queue, int level, int from_back)
+{
+	ring *r = &queue->level[level];
+	b_elem e;
+
+	if(from_back)
+		e = r->items[(r->head + r->count - 1) & (r->capacity - 1)];
+	else {
+		e = r->items[r->head];
+		r->head = (r->head + 1) & (r->capacity - 1);
+	}
+
+	if(--r->count == 0)
+		mark_empty(queue, level);
+
+	queue->size--;		//reflect removal of element
+	return e;
+}
+
+/** Highest and lowest non-empty level; the queue must not be empty **/
+static int highest_level(BucketQueue *queue)
+{
+	int w = 63 - __builtin_clzll(queue->summary);
+	return w * 64 + 63 - __builtin_clzll(queue->bits[w]);
+}
+
+static int lowest_level(BucketQueue *queue)
+{
+	int w = __builtin_ctzll(queue->summary);
+	return w * 64 + __builtin_ctzll(queue->bits[w]);
+}
+
+/** Shared checks of the loud peek/poll calls; returns 0 if there's something to take **/
+static int check_nonempty(BucketQueue *queue)
+{
+	if(queue == NULL) {
+		printf("Queue does not exist.\n");
+		return -1;
+	}
+
+	if(queue->size == 0) {
+		printf("Queue is empty.\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/** Create queue for priorities 0 ... levels-1 **/
+BucketQueue* bqueue_new(int levels)
+{
+	if(levels < 1 || levels > BQUEUE_MAX_LEVELS) {
+		printf("Number of levels must be between 1 and %d.\n", BQUEUE_MAX_LEVELS);
+		return NULL;
+	}
+
+	BucketQueue *queue = (BucketQueue*)calloc(1, sizeof(BucketQueue));	//calloc, so every ring and bitmap word starts out empty
+	if(queue == NULL)
+		return NULL;
+
+	queue->level = (ring*)calloc(levels, sizeof(ring));
+	queue->quantum = (int*)malloc(levels * sizeof(int));
+	if(queue->level == NULL || queue->quantum == NULL) {
+		free(queue->level);
+		free(queue->quantum);
+		free(queue);
+		return NULL;
+	}
+
+	queue->levels = levels;
+
+	//by default the top level gets a quantum of one tick, and every level below twice as much as the one above it:
+	//interactive jobs stay up high and answer quickly, long-running ones sink and run in longer stretches
+	for(int l = 0; l < levels; l++) {
+		int depth = levels - 1 - l;
+		queue->quantum[l] = 1 << (depth < 20 ? depth : 20);
+	}
+
+	return queue;
+}
+
+/** Delete entire queue **/
+void bqueue_free(BucketQueue *queue)
+{
+	if(queue == NULL) {
+		puts("Given queue is uninitialized.");
+		return;
+	}
+
+	for(int l = 0; l < queue->levels; l++)
+		free(queue->level[l].items);
+
+	free(queue->level);
+	free(queue->quantum);
+	free(queue);
+}
+
+/** Insert value at the back of its priority's level **/
+/** returns 0 on success, -1 if the priority is out of range or there was no room (there are no handles as with PrioQueue) **/
+int bqueue_offer(BucketQueue *queue, int priority, int value)
+{
+	if(priority < 0 || priority >= queue->levels) {
+		printf("Priority %d out of range.\n", priority);
+		return -1;
+	}
+
+	return push(queue, priority, (b_elem) { value, 0 });
+}
+
+/** Return value of first element (oldest element of the highest non-empty level), without deleting it **/
+int bqueue_peek(BucketQueue *queue)
+{
+	if(check_nonempty(queue) != 0)
+		return -1;
+
+	ring *r = &queue->level[highest_level(queue)];
+	return r->items[r->head].value;
+}
+
+/** Remove element with highest priority and return its value **/
+int bqueue_poll(BucketQueue *queue)
+{
+	if(check_nonempty(queue) != 0)
+		return -1;
+
+	return pop(queue, highest_level(queue), 0).value;
+}
+
+/** Return value of last element (newest element of the lowest non-empty level), without deleting it **/
+int bqueue_peek_last(BucketQueue *queue)
+{
+	if(check_nonempty(queue) != 0)
+		return -1;
+
+	ring *r = &queue->level[lowest_level(queue)];
+	return r->items[(r->head + r->count - 1) & (r->capacity - 1)].value;
+}
+
+/** Remove element with lowest priority and return its value **/
+int bqueue_poll_last(BucketQueue *queue)
+{
+	if(check_nonempty(queue) != 0)
+		return -1;
+
+	return pop(queue, lowest_level(queue), 1).value;
+}
+
+/** Quiet peek and poll: return 1 and fill in priority and value (either may be NULL) if there was an element, 0 if empty **/
+int bqueue_try_peek(BucketQueue *queue, int *priority, int *value)
+{
+	if(queue == NULL || queue->size == 0)
+		return 0;
+
+	int level = highest_level(queue);
+	ring *r = &queue->level[level];
+
+	if(priority != NULL)
+		*priority = level;
+	if(value != NULL)
+		*value = r->items[r->head].value;
+	return 1;
+}
+
+int bqueue_try_poll(BucketQueue *queue, int *priority, int *value)
+{
+	if(queue == NULL || queue->size == 0)
+		return 0;
+
+	int level = highest_level(queue);
+	b_elem e = pop(queue, level, 0);
+
+	if(priority != NULL)
+		*priority = level;
+	if(value != NULL)
+		*value = e.value;
+	return 1;
+}
+
+/** Return size of queue **/
+int bqueue_size(BucketQueue *queue)
+{
+	return queue->size;
+}
+
+				/** Multi-Level Feedback scheduling **/
+
+/** Set how many ticks a job may use on a level before it is demoted to the level below **/
+void bqueue_set_quantum(BucketQueue *queue, int level, int ticks)
+{
+	if(level < 0 || level >= queue->levels || ticks < 1) {
+		printf("Invalid quantum %d for level %d.\n", ticks, level);
+		return;
+	}
+
+	queue->quantum[level] = ticks;
+}
+
+/** Set how many ticks pass between boosts of every job back to the top level; 0 turns boosting off **/
+void bqueue_set_boost_period(BucketQueue *queue, int ticks)
+{
+	queue->boost_period = ticks > 0 ? ticks : 0;
+	queue->clock = 0;
+}
+
+/** Queue a new job; new jobs start on the top level **/
+int bqueue_submit(BucketQueue *queue, int value)
+{
+	return push(queue, queue->levels - 1, (b_elem) { value, 0 });
+}
+
+/** Take the job to run next; returns 1 and fills in job, or 0 if there is nothing to run **/
+int bqueue_next(BucketQueue *queue, bqueue_job *job)
+{
+	if(queue == NULL || queue->size == 0)
+		return 0;
+
+	job->level = highest_level(queue);
+	b_elem e = pop(queue, job->level, 0);
+	job->value = e.value;
+	job->used = e.used;
+	return 1;
+}
+
+/** Hand back a job that ran for ticks and isn't finished yet **/
+/** a job that has used up its level's quantum moves down a level and starts afresh there, otherwise it stays **/
+int bqueue_yield(BucketQueue *queue, bqueue_job *job, int ticks)
+{
+	job->used += ticks;
+
+	if(job->used >= queue->quantum[job->level] && job->level > 0) {
+		job->level--;
+		job->used = 0;
+	}
+
+	return push(queue, job->level, (b_elem) { job->value, job->used });
+}
+
+/** Move every job to the top level with a fresh quantum, so jobs that sank to the bottom don't starve **/
+static void boost(BucketQueue *queue)
+{
+	int top = queue->levels - 1;
+	ring *r = &queue->level[top];
+
+	//jobs already on top keep their place but get a fresh quantum
+	for(unsigned int i = 0; i < r->count; i++)
+		r->items[(r->head + i) & (r->capacity - 1)].used = 0;
+
+	//then the others follow, higher levels first and in FIFO order within each level.
+	//this visits every level once, which is fine for something that happens once per boost period
+	for(int level = top - 1; level >= 0; level--) {
+		while(queue->level[level].count > 0) {
+			b_elem e = pop(queue, level, 0);
+			b_elem boosted = { e.value, 0 };
+
+			if(push(queue, top, boosted) != 0) {
+				unpop(queue, level, e);		//no room on top: put it back as it was, at the front of its level
+				return;
+			}
+		}
+	}
+}
+
+/** Let ticks of time pass; boosts everything to the top level whenever a boost period is over **/
+void bqueue_tick(BucketQueue *queue, int ticks)
+{
+	if(queue->boost_period == 0)
+		return;
+
+	queue->clock += ticks;
+	if(queue->clock >= queue->boost_period) {
+		queue->clock %= queue->boost_period;
+		boost(queue);
+	}
+}
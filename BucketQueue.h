@@ -0,0 +1,40 @@
+#ifndef BUCKETQUEUE_H
+#define BUCKETQUEUE_H
+
+/** Priority queue for small bounded integer priorities 0 ... levels-1, with O(1) offer and poll **/
+/** Same value/priority semantics as PrioQueue: higher priority leaves first, equal priorities leave first-in first-out **/
+/** On top of it sits a multi-level feedback scheduler: jobs are demoted when they use up their level's time quantum, **/
+/** and everything is boosted back to the top level periodically **/
+
+#define BQUEUE_MAX_LEVELS 4096
+
+typedef struct BucketQueue BucketQueue;
+
+/** a job taken out of the queue by bqueue_next, to be handed back to bqueue_yield if it isn't finished **/
+typedef struct
+{
+	int value;
+	int level;		//the level it was taken from
+	int used;		//ticks it has used on that level so far
+} bqueue_job;
+
+BucketQueue* bqueue_new(int levels);
+void bqueue_free(BucketQueue *queue);
+
+int bqueue_offer(BucketQueue *queue, int priority, int value);
+int bqueue_peek(BucketQueue *queue);
+int bqueue_poll(BucketQueue *queue);
+int bqueue_peek_last(BucketQueue *queue);
+int bqueue_poll_last(BucketQueue *queue);
+int bqueue_try_peek(BucketQueue *queue, int *priority, int *value);
+int bqueue_try_poll(BucketQueue *queue, int *priority, int *value);
+int bqueue_size(BucketQueue *queue);
+
+void bqueue_set_quantum(BucketQueue *queue, int level, int ticks);
+void bqueue_set_boost_period(BucketQueue *queue, int ticks);
+int bqueue_submit(BucketQueue *queue, int value);
+int bqueue_next(BucketQueue *queue, bqueue_job *job);
+int bqueue_yield(BucketQueue *queue, bqueue_job *job, int ticks);
+void bqueue_tick(BucketQueue *queue, int ticks);
+
+#endif
@@ -1,129 +1,379 @@
 #include "PrioQueue.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 
 						/** Implementation of a Priority Queue **/
 /** Features deletion, insertion, printing of, and application of arbitrary function on queue. **/
 /** Useful for scheduling paradigms: tweak priority to fit principle of schedule; for example, in Multi-Level Feedback, **/
 /** priority can be determined by length of job and time spent utilizing CPU **/
+/** Elements live in one contiguous array laid out as an implicit min-max heap, so both ends of the queue are O(log n) away **/
+/** Offering returns a handle, through which a queued element can later be re-prioritized or removed **/
 /** Samantha Tite-Webber, 2015 **/
 
+#define PQUEUE_INITIAL_CAPACITY 16
+
 typedef struct q_elem_s
 {
-	int value;		//each element in the priority queue has a value, a priority, and a pointer to
-	int priority;		//the next element in the queue
-	struct q_elem_s *next;	
+	int value;		//each element in the priority queue has a value, a priority, and a sequence number
+	int priority;		//which records when it was offered, so that elements of equal priority
+	unsigned int seq;	//still leave the queue first-in first-out.
+	int handle;		//it also carries the handle its offer returned, so we can tell the handle where the element moved
 } q_elem;
 
 struct PrioQueue
 {
 	int size;		//how many elements are in the queue
-	q_elem *root;		//pointer to the first element in the queue
+	int capacity;		//how many elements fit into heap before it has to grow
+	unsigned int next_seq;	//sequence number handed to the next offered element
+	q_elem *heap;		//the elements, as an implicit binary tree: the children of heap[i] are heap[2i+1] and heap[2i+2].
+				//levels alternate: an element on an even level (the root's) leaves the queue before everything below it,
+				//an element on an odd level leaves after everything below it. so the first element is heap[0],
+				//and the last one is heap[1] or heap[2]
+	int *pos;		//pos[handle] is the index in heap of the element with that handle. the handles of all capacity slots
+				//form a permutation of 0 ... capacity-1: unused slots beyond size hold the handles that are free,
+				//and their pos points beyond size too, so a handle is live exactly when pos[handle] < size
 };
 
+/** Does element a leave the queue before element b? **/
+/** higher priority first; on equal priority, whoever was offered first (the difference is taken signed so the counter may wrap around) **/
+static int comes_before(const q_elem *a, const q_elem *b)
+{
+	if(a->priority != b->priority)
+		return a->priority > b->priority;
+
+	return (int)(a->seq - b->seq) < 0;
+}
+
+/** Is index i on an even level, whose elements come before their descendants? **/
+static int on_first_level(int i)
+{
+	return ((31 - __builtin_clz((unsigned int)i + 1)) & 1) == 0;	//the level is floor(log2(i+1))
+}
+
+/** Does a belong closer to the root than b, for an element on a level of the given kind? **/
+static int outranks(const q_elem *a, const q_elem *b, int first_level)
+{
+	return first_level ? comes_before(a, b) : comes_before(b, a);
+}
+
+/** Store element e at index i, and tell its handle where it is now **/
+static void put(PrioQueue *queue, int i, q_elem e)
+{
+	queue->heap[i] = e;
+	queue->pos[e.handle] = i;
+}
+
+static void swap_elems(PrioQueue *queue, int i, int j)
+{
+	q_elem tmp = queue->heap[i];
+	put(queue, i, queue->heap[j]);
+	put(queue, j, tmp);
+}
+
+/** Move the element at index i up through its grandparents, which are on the same kind of level; returns whether it moved **/
+static int bubble_up(PrioQueue *queue, int i)
+{
+	int first_level = on_first_level(i);
+	int start = i;
+
+	while(i > 2) {
+		int grandparent = ((i - 1) / 2 - 1) / 2;
+
+		if(!outranks(&queue->heap[i], &queue->heap[grandparent], first_level))
+			break;
+
+		swap_elems(queue, i, grandparent);
+		i = grandparent;
+	}
+
+	return i != start;
+}
+
+/** Move the element at index i down until it outranks its children and grandchildren **/
+static void trickle_down(PrioQueue *queue, int i)
+{
+	int first_level = on_first_level(i);
+
+	while(1) {
+		//find the child or grandchild that outranks all others
+		int best = -1;
+		int candidates[6] = { 2*i + 1, 2*i + 2, 4*i + 3, 4*i + 4, 4*i + 5, 4*i + 6 };
+
+		for(int c = 0; c < 6 && candidates[c] < queue->size; c++) {
+			if(best < 0 || outranks(&queue->heap[candidates[c]], &queue->heap[best], first_level))
+				best = candidates[c];
+		}
+
+		if(best < 0 || !outranks(&queue->heap[best], &queue->heap[i], first_level))
+			break;		//no descendants, or we already outrank them
+
+		swap_elems(queue, i, best);
+
+		if(best <= 2*i + 2)
+			break;		//swapped with a child: that's on the other kind of level and has no grandchildren of ours below it
+
+		//swapped with a grandchild: our element may now be on the wrong side of the parent in between
+		int parent = (best - 1) / 2;
+		if(outranks(&queue->heap[best], &queue->heap[parent], !first_level))
+			swap_elems(queue, best, parent);
+
+		i = best;
+	}
+}
+
+/** Put the element at index i back in order after it was placed there or changed, whichever way it has to move **/
+static void restore(PrioQueue *queue, int i)
+{
+	if(i > 0) {
+		int parent = (i - 1) / 2;
+
+		//if it outranks its parent by the parent's standard, it belongs among the parent's level kind:
+		//swap them, let the old parent find its place below, and carry on upwards from the parent's spot
+		if(outranks(&queue->heap[i], &queue->heap[parent], !on_first_level(i))) {
+			swap_elems(queue, i, parent);
+			trickle_down(queue, i);
+			bubble_up(queue, parent);
+			return;
+		}
+
+		if(bubble_up(queue, i))
+			return;		//whatever came down into i came from above, so it's in order with everything below
+	}
+
+	trickle_down(queue, i);
+}
+
+/** Take the element at index i out of the heap, filling its place with the last element **/
+static void remove_at(PrioQueue *queue, int i)
+{
+	queue->size--;		//reflect removal of element
+
+	if(i == queue->size)
+		return;		//it was the last element anyway, its slot (and with it its handle) is free now
+
+	//fill the hole with the last element, and park the removed element (and with it its handle) in the slot that frees up
+	q_elem removed = queue->heap[i];
+	put(queue, i, queue->heap[queue->size]);
+	put(queue, queue->size, removed);
+	restore(queue, i);
+}
+
+/** Index of the element that leaves the queue last; the queue must not be empty **/
+static int last_index(PrioQueue *queue)
+{
+	if(queue->size <= 2)
+		return queue->size - 1;
+
+	return comes_before(&queue->heap[1], &queue->heap[2]) ? 2 : 1;
+}
+
+/** Restore heap order over the whole array bottom-up (Floyd's method), O(n) instead of n separate insertions **/
+static void heapify(PrioQueue *queue)
+{
+	for(int i = (queue->size - 2) / 2; i >= 0; i--)
+		trickle_down(queue, i);
+}
+
+/** Make room for at least min_capacity elements; capacity doubles so growth is amortized O(1) per offer **/
+/** the heap never shrinks while the queue lives, so a queue that has reached its working size stops touching the allocator **/
+static int grow(PrioQueue *queue, int min_capacity)
+{
+	if(min_capacity <= queue->capacity)
+		return 0;
+
+	int capacity = queue->capacity ? queue->capacity : PQUEUE_INITIAL_CAPACITY;
+	while(capacity < min_capacity)
+		capacity = (capacity > INT_MAX / 2) ? min_capacity : capacity * 2;
+
+	q_elem *heap = (q_elem*)realloc(queue->heap, (size_t)capacity * sizeof(q_elem));
+	if(heap != NULL)
+		queue->heap = heap;	//keep the bigger array even if pos can't follow; capacity just stays where it was
+
+	int *pos = (heap != NULL) ? (int*)realloc(queue->pos, (size_t)capacity * sizeof(int)) : NULL;
+	if(pos == NULL) {
+		printf("Could not grow queue.\n");
+		return -1;
+	}
+
+	queue->pos = pos;
+
+	//the new slots bring new free handles with them
+	for(int i = queue->capacity; i < capacity; i++) {
+		queue->heap[i].handle = i;
+		queue->pos[i] = i;
+	}
+
+	queue->capacity = capacity;
+	return 0;
+}
+
 /** Create queue **/
 PrioQueue* pqueue_new()
 {
-	//need to allocate space for one PrioQueue by means of malloc. This space will be as large as one PrioQueue struct. Because the PrioQueue is currently empty, the root will point to nowhere.
+	//need to allocate space for one PrioQueue by means of malloc. This space will be as large as one PrioQueue struct. Because the PrioQueue is currently empty, it has no heap storage yet; the first offer allocates it.
 
 	PrioQueue* prioQ = (PrioQueue*)malloc(sizeof(PrioQueue));	//malloc returns a pointer (automatically of type void, to indicate that it points to a region of unknown data type, but in this case the pointer is of type PrioQueue as we've casted it so) which points to a region of memory of size specified in malloc(THIS AREA)
-	prioQ->root = NULL;
+	if(prioQ == NULL)
+		return NULL;
+
+	prioQ->size = 0;
+	prioQ->capacity = 0;
+	prioQ->next_seq = 0;
+	prioQ->heap = NULL;
+	prioQ->pos = NULL;
 	return prioQ;
 }
 
 /** Delete entire queue **/
 void pqueue_free(PrioQueue *queue)
 {
-	//start at the top of the queue and keep going until we hit an element whose "next" == NULL.
-	//at each element, we "delete" it, and once we've deleted the last element, we delete the queue itself, and then free the memory. we delete using the free(memoryAddress) function, which frees a space in memory at the specified address
+	//all elements sit in one array, so deleting the queue is three frees no matter how many elements it holds
 
 	//first check if the queue is initialized:
 	if(queue == NULL) {
 		puts("Given queue is uninitialized.");
+		return;
 	}
-	
-	else if(queue->root == NULL) {		//because queue is a pointer to a struct, we can access its members using the arrow notation
-		puts("Given queue is empty.");
-	}
-	
-	else {
-		//we need a current element and a to-delete element. we set the root as the current element, and set the root as the element to-delete element as well, and then set the current element as root->next. so we start with the current element, set its next as the current element, set it as the to-delete element, and then delete it. after we're done, we delete the queue itself.
-
-		q_elem *current = queue->root;
-		q_elem *to_delete = NULL;
 
-		//if the queue only had a root, what would happen...? we wouldn't enter the loop, we'd just delete the root and then the queue! perfekt.
-		while(current->next != NULL) {		//as soon as current->next equals NULL, we're at the end. we'll be out of the loop and at that point can delete current itself.
+	free(queue->heap);	//free(NULL) is fine, so an empty queue needs no special case
+	free(queue->pos);
+	free(queue);		//now take the queue itself out of memory
+}
 
-			current = current->next;	//move on to the next element
-			to_delete = current;		//delete the element which came before the "next" (now the current)
-			free(to_delete);	//(well here we actually delete)
-		}
+/** Preallocate room for count elements, so that offers up to that size never call the allocator **/
+/** returns 0 on success, -1 if the memory could not be had **/
+int pqueue_reserve(PrioQueue *queue, int count)
+{
+	if(queue == NULL) {
+		printf("Queue does not exist.\n");
+		return -1;
+	}
 
-		free(current);		//we stopped as soon as we found the element whose next pointed to nothing, so we need to delete that element here
-		free(queue);		//now take the queue itself out of memory
+	return grow(queue, count);
+}
 
+/** Remove every element but keep the storage, so a queue can be refilled without allocating again **/
+void pqueue_clear(PrioQueue *queue)
+{
+	if(queue == NULL) {
+		printf("Queue does not exist.\n");
+		return;
 	}
+
+	queue->size = 0;
+	queue->next_seq = 0;		//nothing left to be ordered against, so the sequence can start over
 }
 
 //** Insert value into queue **/
 /** inserted on basis of its priority **/
 /** higher priority = higher place in queue **/
+/** returns the element's handle (>= 0), valid until the element leaves the queue; -1 if there was no room **/
 int pqueue_offer(PrioQueue *queue, int priority, int value)
 {
-	//create element to be added
-	q_elem *new_guy = (q_elem*)malloc(sizeof(q_elem));
+	if(queue->size == queue->capacity && grow(queue, queue->size + 1) != 0)
+		return -1;
+
+	//place the new element at the bottom of the heap and let it rise to where it belongs.
+	//the slot already holds a free handle, which the new element takes over
+	q_elem *new_guy = &queue->heap[queue->size];
 	new_guy->value = value;
 	new_guy->priority = priority;
-	new_guy->next = NULL;
-
-	//is there yet an initialized root?
-	if(queue->root == NULL) {
-		//if not, make the element to be added the root
-		queue->root = new_guy;
-		queue->size++;		//reflect addition of new element
-		return queue->root->value;	//return because we're done here
-	}
-	
-	//otherwise....
-
-	if(priority > queue->root->priority) {
-		new_guy->next = queue->root;	//point new guy's next at root
-		queue->root = new_guy;		//point queue's root at new_guy
-		queue->size++;		//reflect addition of new element
-		return new_guy->value;
-	}
-	
-	//start with first element in queue
-	q_elem *current = queue->root;
-
-	while(current != NULL) {
-
-		//if we've reached the end of the queue
-		if(current->next == NULL) {
-			
-			current->next = new_guy;
-			queue->size++;		//reflect addition of new element
-			return new_guy->value;
-		}
-		
-		//check if new element should be inserted between two elements
-		else if(priority >= current->next->priority) {
+	new_guy->seq = queue->next_seq++;
+	int handle = new_guy->handle;
 
-			//point new guy's next at element that used to follow current
-			new_guy->next = current->next;
+	queue->size++;		//reflect addition of new element
+	restore(queue, queue->size - 1);
+	return handle;
+}
 
-			//point current element's next at new guy
-			current->next = new_guy;
-			queue->size++;		//reflect addition of new element
-			return new_guy->value;
-		}
-		
-		else if(priority < current->next->priority) {
-			current = current->next;	
-		}
+/** Insert count elements at once; priorities[i] goes with values[i] **/
+/** elements of equal priority keep their order within the batch, after anything already queued **/
+/** if handles is not NULL, handles[i] receives the handle of element i **/
+/** returns how many elements were inserted: count, or 0 if there was no room for them **/
+int pqueue_offer_n(PrioQueue *queue, const int *priorities, const int *values, int *handles, int count)
+{
+	if(queue == NULL) {
+		printf("Queue does not exist.\n");
+		return 0;
+	}
+
+	if(count <= 0)
+		return 0;
+
+	if(count > INT_MAX - queue->size || grow(queue, queue->size + count) != 0)
+		return 0;		//grow once for the whole batch, or not at all
+
+	int old_size = queue->size;
+
+	//append the batch behind the existing elements
+	for(int i = 0; i < count; i++) {
+		q_elem *new_guy = &queue->heap[old_size + i];
+		new_guy->value = values[i];
+		new_guy->priority = priorities[i];
+		new_guy->seq = queue->next_seq++;
+		if(handles != NULL)
+			handles[i] = new_guy->handle;
+	}
+	queue->size += count;		//reflect addition of new elements
+
+	//a small batch into a big queue is cheapest inserted one by one (count * log n);
+	//once the batch is a sizable part of the queue, rebuilding the heap in one linear pass wins
+	if(count > old_size / 4)
+		heapify(queue);
+	else {
+		for(int i = old_size; i < queue->size; i++)
+			restore(queue, i);
+	}
+
+	return count;
+}
+
+/** Is handle that of an element that is still in the queue? **/
+static int live_handle(PrioQueue *queue, int handle)
+{
+	return handle >= 0 && handle < queue->capacity && queue->pos[handle] < queue->size;
+}
+
+/** Change the priority of a queued element, e.g. to age it or boost it, in O(log n) **/
+/** it keeps its place among elements of equal priority that were offered after it **/
+/** returns 0 on success, -1 if the handle doesn't belong to a queued element **/
+int pqueue_update_priority(PrioQueue *queue, int handle, int priority)
+{
+	if(queue == NULL) {
+		printf("Queue does not exist.\n");
+		return -1;
+	}
+
+	if(!live_handle(queue, handle)) {
+		printf("No such element in queue.\n");
+		return -1;
 	}
-	return -1;
+
+	int i = queue->pos[handle];
+	queue->heap[i].priority = priority;
+	restore(queue, i);
+	return 0;
+}
+
+/** Remove a queued element wherever it is, in O(log n), and return its value **/
+int pqueue_remove(PrioQueue *queue, int handle)
+{
+	if(queue == NULL) {
+		printf("Queue does not exist.\n");
+		return -1;
+	}
+
+	if(!live_handle(queue, handle)) {
+		printf("No such element in queue.\n");
+		return -1;
+	}
+
+	int i = queue->pos[handle];
+	int val = queue->heap[i].value;
+	remove_at(queue, i);
+	return val;
 }
 
 /** Return value of first element (element with highest priority in the queue, aka root), without deleting it **/
@@ -134,49 +384,58 @@ int pqueue_peek(PrioQueue *queue)
 		return -1;
 	}
 
-	else if(queue->root == NULL) {
+	else if(queue->size == 0) {
 		printf("Queue is empty.\n");
 		return -1;
 	}
 
 	else
-		return queue->root->value;
+		return queue->heap[0].value;
 }
 
-/** Return value of last element in the queue **/
-int pqueue_get_last(PrioQueue *queue) {
+/** Return value of last element (element with lowest priority in the queue), without deleting it **/
+int pqueue_peek_last(PrioQueue *queue)
+{
+	if(queue == NULL) {
+		printf("Queue does not exist.\n");
+		return -1;
+	}
+
+	else if(queue->size == 0) {
+		printf("Queue is empty.\n");
+		return -1;
+	}
 
+	else
+		return queue->heap[last_index(queue)].value;
+}
+
+/** Remove element with lowest priority and return its value, e.g. to shed the least important work **/
+int pqueue_poll_last(PrioQueue *queue)
+{
 	if(queue == NULL) {
 		printf("Queue does not exist.\n");
 		return -1;
 	}
 
-	else if(queue->root == NULL) {
+	else if(queue->size == 0) {
 		printf("Queue is empty.\n");
 		return -1;
 	}
 
 	else {		//*something* exists
-		q_elem* current = queue->root;
-		
-		while(current->next != NULL) {
-
-			//if we've reached the end of the queue
-			if(current->next->next == NULL) {
-
-				int last_val = current->next->value;	
-				free(current->next);		//remove last element
-				current->next = NULL;	//make element which preceded deleted element the new last element
-				queue->size--;		//reflect removal of element
-				return last_val;	//return the value of the last element, which we've already removed
-			}
-
-			else	//otherwise, continue down the queue
-				current = current->next;
-		}
+		int last = last_index(queue);
+		int last_val = queue->heap[last].value;
+		remove_at(queue, last);		//remove last element
+		return last_val;	//return the value of the last element, which we've already removed
 	}
+}
+
+/** Remove last element in the queue and return its value **/
+/** kept for existing callers: despite the name it removes the element, like pqueue_poll_last. use pqueue_peek_last to only look **/
+int pqueue_get_last(PrioQueue *queue) {
 
-	return -1;
+	return pqueue_poll_last(queue);
 }
 
 /** Remove element with highest priority and return its value **/
@@ -188,21 +447,61 @@ int pqueue_poll(PrioQueue *queue)
 		return -1;
 	}
 
-	else if(queue->root == NULL) {
+	else if(queue->size == 0) {
 		printf("Queue is empty.\n");
 		return -1;
 	}
 
 	else {		//*something* exists
-		int rootsVal = queue->root->value;	//get root's value so we can return it after deleting root.
-		q_elem* deletePtr = queue->root;	//point the queue to the new root, the element that formerly followed root. root is now lost.
-		queue->root = queue->root->next;
-		free(deletePtr);
-		queue->size--;		//reflect removal of element
+		int rootsVal = queue->heap[0].value;	//get root's value so we can return it after deleting root.
+		remove_at(queue, 0);
 		return rootsVal;	//return the value of the element with the highest priority, which we've already removed
 	}
+}
+
+/** Remove up to count elements of highest priority, writing them in the order they leave the queue **/
+/** priorities may be NULL if the caller only wants the values; returns how many elements were removed **/
+int pqueue_poll_n(PrioQueue *queue, int *priorities, int *values, int count)
+{
+	if(queue == NULL) {
+		printf("Queue does not exist.\n");
+		return 0;
+	}
+
+	if(count > queue->size)
+		count = queue->size;
+
+	for(int i = 0; i < count; i++) {
+		if(priorities != NULL)
+			priorities[i] = queue->heap[0].priority;
+		values[i] = queue->heap[0].value;
+		remove_at(queue, 0);
+	}
 
-	return -1;
+	return count < 0 ? 0 : count;
+}
+
+/** Quiet variants of peek and poll for callers that expect empty queues, e.g. workers racing for jobs **/
+/** both return 1 and fill in priority and value (either may be NULL) if there was an element, 0 if the queue is empty **/
+int pqueue_try_peek(PrioQueue *queue, int *priority, int *value)
+{
+	if(queue == NULL || queue->size == 0)
+		return 0;
+
+	if(priority != NULL)
+		*priority = queue->heap[0].priority;
+	if(value != NULL)
+		*value = queue->heap[0].value;
+	return 1;
+}
+
+int pqueue_try_poll(PrioQueue *queue, int *priority, int *value)
+{
+	if(!pqueue_try_peek(queue, priority, value))
+		return 0;
+
+	remove_at(queue, 0);
+	return 1;
 }
 
 /** Return size of queue **/
@@ -211,25 +510,33 @@ int pqueue_size(PrioQueue *queue)
 	return queue->size;	//was incremented with every addition of an element and decremented with every removal of an element
 }
 
+static int compare_elems(const void *a, const void *b)
+{
+	return comes_before((const q_elem*)a, (const q_elem*)b) ? -1 : 1;
+}
+
 /** Print queue **/
 void pqueue_print(PrioQueue *queue)
 {
-	q_elem* current = queue->root;
-	//char string_rep[15];
+	if(queue->size == 0)
+		return;
+
+	//the heap is only partially ordered, so print a sorted copy to show the elements in the order they'll leave the queue
+	q_elem *sorted = (q_elem*)malloc(queue->size * sizeof(q_elem));
+	if(sorted == NULL) {
+		printf("Could not print queue.\n");
+		return;
+	}
 
-	while(current != NULL) {
+	memcpy(sorted, queue->heap, queue->size * sizeof(q_elem));
+	qsort(sorted, queue->size, sizeof(q_elem), compare_elems);
 
-		//if we've reached the end of the queue
-		if(current->next == NULL) {
-			printf("(%d, %d) ", current->priority, current->value);
-			printf("\n");		//print a new line for cleanliness
-			return;		//leave because we're done here
-		}
-
-		//string_rep = (current->next == NULL) ? current->priority 
-		printf("(%d, %d) ", current->priority, current->value);
-		current = current->next;
+	for(int i = 0; i < queue->size; i++) {
+		printf("(%d, %d) ", sorted[i].priority, sorted[i].value);
 	}
+	printf("\n");		//print a new line for cleanliness
+
+	free(sorted);
 }
 
 /** Print given priority and value in clean format **/
@@ -238,12 +545,66 @@ void print(const int *priority, const int *value) {
 }
 
 /* Apply given function to each element in the queue **/
+/** elements are visited in storage order, not in priority order **/
 void pqueue_apply(PrioQueue *queue, void (*func)(const int *, const int *))
 {
-	q_elem *current;
-	for (current = queue->root; current != NULL; current = current->next)
+	for(int i = 0; i < queue->size; i++)
 	{
-		func(&current->priority, &current->value);
+		func(&queue->heap[i].priority, &queue->heap[i].value);
 	}
 }
 
+/** Walk the queue without calling back: start with *cursor = 0, and each call yields the next element's priority and value **/
+/** (either may be NULL) and returns 1, until it returns 0 at the end. storage order, not priority order; don't change the queue meanwhile **/
+int pqueue_iter_next(PrioQueue *queue, int *cursor, int *priority, int *value)
+{
+	if(queue == NULL || *cursor < 0 || *cursor >= queue->size)
+		return 0;
+
+	const q_elem *e = &queue->heap[(*cursor)++];
+
+	if(priority != NULL)
+		*priority = e->priority;
+	if(value != NULL)
+		*value = e->value;
+	return 1;
+}
+
+/** Adjust the priorities of all elements at once, e.g. for an aging pass **/
+/** func is called a single time with every priority and value in two plain arrays of count ints (priorities[i] goes with values[i]), **/
+/** so it can run one tight loop the compiler can vectorize instead of an indirect call per element. afterwards the heap is rebuilt **/
+/** in one linear pass. returns 0 on success, -1 if the scratch space could not be allocated **/
+int pqueue_apply_priorities(PrioQueue *queue, void (*func)(int *priorities, const int *values, int count))
+{
+	if(queue == NULL) {
+		printf("Queue does not exist.\n");
+		return -1;
+	}
+
+	int count = queue->size;
+	if(count <= 0)
+		return 0;
+
+	int *priorities = (int*)malloc(2 * (size_t)count * sizeof(int));	//one block for both arrays
+	if(priorities == NULL) {
+		printf("Could not allocate scratch space.\n");
+		return -1;
+	}
+	int *values = priorities + count;
+
+	//gather into contiguous arrays, let func adjust them, scatter the priorities back
+	for(int i = 0; i < count; i++) {
+		priorities[i] = queue->heap[i].priority;
+		values[i] = queue->heap[i].value;
+	}
+
+	func(priorities, values, count);
+
+	for(int i = 0; i < count; i++)
+		queue->heap[i].priority = priorities[i];
+
+	heapify(queue);		//sequence numbers are untouched, so equal priorities still leave first-in first-out
+
+	free(priorities);
+	return 0;
+}
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "PrioQueue_select.h"
+
+				/** Microbenchmarks for the priority queue operations **/
+/** For queue sizes from 10 up to MAXSIZE (powers of ten) and several priority distributions, fills a queue with offers, **/
+/** runs pqueue_apply and pqueue_apply_priorities over it, sheds half of it with pqueue_get_last and drains the rest with pqueue_poll. **/
+/** Reports throughput and p50/p99 latency per operation as CSV (default) or JSON, for tracking regressions across engines: **/
+/** build against PrioQueue.c, or with -DPQUEUE_USE_BUCKETS=<levels> against BucketQueue.c. **/
+
+#ifdef PQUEUE_USE_BUCKETS
+#define ENGINE "bucket"
+#define PRIORITY_RANGE PQUEUE_USE_BUCKETS
+#else
+#define ENGINE "heap"
+#define PRIORITY_RANGE (1 << 30)
+#endif
+
+#define MAX_SAMPLES 100000	//latency samples per operation; bigger runs time every k-th operation only
+#define DUPLICATE_LEVELS 4	//distinct priorities in the heavy-duplicate distribution
+
+enum { UNIFORM, SORTED, REVERSE, DUPLICATES, NUM_DISTRIBUTIONS };
+const char *DISTRIBUTION[] = { "uniform", "sorted", "reverse", "duplicates" };
+
+typedef struct
+{
+	const char *op;
+	long ops;		//operations performed
+	double seconds;		//wall time for all of them
+	double *samples;	//latencies of the timed operations, in ns
+	int count;		//how many were timed
+} measurement;
+
+static int g_json = 0;
+static int g_first_record = 1;
+static volatile long g_sink;	//keeps the apply callback from being optimized away
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/** Priority of the i-th of n offers under the given distribution **/
+static int priority_for(int distribution, long i, long n, unsigned int *seed)
+{
+	switch(distribution) {
+		case SORTED:
+			return (int)((double)i / n * (PRIORITY_RANGE - 1));		//ascending: each offer outranks everything queued
+		case REVERSE:
+			return (int)((double)(n - 1 - i) / n * (PRIORITY_RANGE - 1));	//descending: each offer goes to the back
+		case DUPLICATES:
+			return rand_r(seed) % DUPLICATE_LEVELS;
+		default:
+			return rand_r(seed) % PRIORITY_RANGE;
+	}
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+static double percentile(double *sorted, int count, double p)
+{
+	if(count == 0)
+		return 0;
+
+	int i = (int)(p * (count - 1) + 0.5);
+	return sorted[i];
+}
+
+static void report(measurement *m, int distribution, long size)
+{
+	qsort(m->samples, m->count, sizeof(double), compare_doubles);
+
+	double mops = m->ops / m->seconds / 1e6;
+	double p50 = percentile(m->samples, m->count, 0.50);
+	double p99 = percentile(m->samples, m->count, 0.99);
+
+	if(g_json) {
+		printf("%s\n  {\"engine\": \"%s\", \"op\": \"%s\", \"distribution\": \"%s\", \"size\": %ld, \"ops\": %ld, "
+			"\"seconds\": %.6f, \"mops_per_sec\": %.3f, \"p50_ns\": %.1f, \"p99_ns\": %.1f}",
+			g_first_record ? "" : ",", ENGINE, m->op, DISTRIBUTION[distribution], size, m->ops,
+			m->seconds, mops, p50, p99);
+	}
+	else {
+		printf("%s,%s,%s,%ld,%ld,%.6f,%.3f,%.1f,%.1f\n", ENGINE, m->op, DISTRIBUTION[distribution],
+			size, m->ops, m->seconds, mops, p50, p99);
+	}
+
+	g_first_record = 0;
+}
+
+/** Time one operation; every stride-th call is timed individually for the latency percentiles **/
+#define MEASURE(m, i, stride, call)					\
+	do {								\
+		if((i) % (stride) == 0 && (m).count < MAX_SAMPLES) {	\
+			double t0 = now_ns();				\
+			call;						\
+			(m).samples[(m).count++] = now_ns() - t0;	\
+		}							\
+		else							\
+			call;						\
+	} while(0)
+
+#ifndef PQUEUE_USE_BUCKETS
+static void touch(const int *priority, const int *value)
+{
+	g_sink += *priority ^ *value;
+}
+
+/** Aging pass for pqueue_apply_priorities: everything gains a little, odd values a little more **/
+static void age(int *priorities, const int *values, int count)
+{
+	for(int i = 0; i < count; i++)
+		priorities[i] += 1 + (values[i] & 1);
+}
+#endif
+
+void run(int distribution, long size, double *samples)
+{
+	unsigned int seed = 42;
+	long stride = size / MAX_SAMPLES + 1;
+	PrioQueue *queue = pqueue_new();
+
+	//offer: build the queue up from empty
+	measurement offer = { "offer", size, 0, samples, 0 };
+	double start = now_ns();
+	for(long i = 0; i < size; i++) {
+		int priority = priority_for(distribution, i, size, &seed);
+		MEASURE(offer, i, stride, pqueue_offer(queue, priority, (int)i));
+	}
+	offer.seconds = (now_ns() - start) / 1e9;
+	report(&offer, distribution, size);
+
+#ifndef PQUEUE_USE_BUCKETS
+	//apply: a whole pass over the queue is one sample; repeat small queues so the pass count is meaningful
+	long passes = 1000000 / size + 1;
+	if(passes > MAX_SAMPLES)
+		passes = MAX_SAMPLES;
+
+	measurement apply = { "apply", passes * size, 0, samples, 0 };
+	start = now_ns();
+	for(long i = 0; i < passes; i++)
+		MEASURE(apply, i, 1, pqueue_apply(queue, touch));
+	apply.seconds = (now_ns() - start) / 1e9;
+	report(&apply, distribution, size);
+
+	//apply_priorities: the same passes, adjusting every priority in bulk and rebuilding the heap
+	measurement bulk = { "apply_priorities", passes * size, 0, samples, 0 };
+	start = now_ns();
+	for(long i = 0; i < passes; i++)
+		MEASURE(bulk, i, 1, pqueue_apply_priorities(queue, age));
+	bulk.seconds = (now_ns() - start) / 1e9;
+	report(&bulk, distribution, size);
+#endif
+
+	//get_last: shed the lower half
+	long half = size / 2;
+	measurement last = { "get_last", half, 0, samples, 0 };
+	start = now_ns();
+	for(long i = 0; i < half; i++)
+		MEASURE(last, i, stride, pqueue_get_last(queue));
+	last.seconds = (now_ns() - start) / 1e9;
+	report(&last, distribution, size);
+
+	//poll: drain what's left
+	long rest = pqueue_size(queue);
+	measurement poll = { "poll", rest, 0, samples, 0 };
+	start = now_ns();
+	for(long i = 0; i < rest; i++)
+		MEASURE(poll, i, stride, pqueue_poll(queue));
+	poll.seconds = (now_ns() - start) / 1e9;
+	report(&poll, distribution, size);
+
+	pqueue_free(queue);
+}
+
+int main(int argc, char** argv) {
+
+	long max_size = 10000000;
+
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "--json") == 0)
+			g_json = 1;
+		else if(strcmp(argv[i], "--csv") == 0)
+			g_json = 0;
+		else
+			max_size = strtol(argv[i], NULL, 10);
+	}
+
+	if(max_size < 10) {
+		printf("Usage: pqueue_bench [--csv|--json] [MAXSIZE]\n");
+		return EXIT_FAILURE;
+	}
+
+	double *samples = (double*)malloc(MAX_SAMPLES * sizeof(double));
+	if(samples == NULL) {
+		printf("Could not allocate sample buffer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if(g_json)
+		printf("[");
+	else
+		printf("engine,op,distribution,size,ops,seconds,mops_per_sec,p50_ns,p99_ns\n");
+
+	for(long size = 10; size <= max_size; size *= 10) {
+		for(int distribution = 0; distribution < NUM_DISTRIBUTIONS; distribution++)
+			run(distribution, size, samples);
+	}
+
+	if(g_json)
+		printf("\n]\n");
+
+	free(samples);
+	return 0;
+}
@@ -0,0 +1,158 @@
+#ifndef PRIOQUEUE_GENERIC_H
+#define PRIOQUEUE_GENERIC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+/** Typed priority queue, stamped out per payload type: **/
+/**
+	PQUEUE_DEFINE(jobq, struct job)
+
+	jobq *q = jobq_new();
+	jobq_offer(q, priority, job);		//the job is copied into the queue's own storage
+	struct job next;
+	while(jobq_poll(q, NULL, &next)) ...	//NULL: the priority isn't wanted
+	jobq_free(q);
+**/
+/** Payloads live inline next to their priority in one contiguous array laid out as a 4-ary heap, so there is no side table, **/
+/** no per-element allocation and no pointer to chase. Same semantics as PrioQueue: higher priority leaves first, **/
+/** equal priorities first-in first-out. **/
+
+#define PQUEUE_GENERIC_ARITY 4
+#define PQUEUE_GENERIC_INITIAL_CAPACITY 16
+
+#define PQUEUE_DEFINE(name, type)										\
+															\
+typedef struct													\
+{															\
+	int priority;		/* priority and sequence number up front: they're all the heap compares */		\
+	unsigned int seq;												\
+	type payload;													\
+} name##_elem;													\
+															\
+typedef struct													\
+{															\
+	int size;		/* how many elements are in the queue */					\
+	int capacity;		/* how many fit into heap before it has to grow */				\
+	unsigned int next_seq;	/* sequence number handed to the next offered element */			\
+	name##_elem *heap;	/* heap[0] is the root, the children of heap[i] are heap[4i+1 ... 4i+4] */	\
+} name;														\
+															\
+static inline int name##_comes_before(const name##_elem *a, const name##_elem *b)				\
+{															\
+	if(a->priority != b->priority)											\
+		return a->priority > b->priority;									\
+	return (int)(a->seq - b->seq) < 0;										\
+}															\
+															\
+static inline name* name##_new(void)										\
+{															\
+	name *queue = (name*)malloc(sizeof(name));									\
+	if(queue == NULL)												\
+		return NULL;												\
+	queue->size = 0;												\
+	queue->capacity = 0;												\
+	queue->next_seq = 0;												\
+	queue->heap = NULL;												\
+	return queue;													\
+}															\
+															\
+static inline void name##_free(name *queue)									\
+{															\
+	if(queue == NULL)												\
+		return;													\
+	free(queue->heap);												\
+	free(queue);													\
+}															\
+															\
+/* make room for count elements; returns 0 on success, -1 if the memory could not be had */			\
+static inline int name##_reserve(name *queue, int count)							\
+{															\
+	if(count <= queue->capacity)											\
+		return 0;												\
+	int capacity = queue->capacity ? queue->capacity : PQUEUE_GENERIC_INITIAL_CAPACITY;			\
+	while(capacity < count)												\
+		capacity = (capacity > INT_MAX / 2) ? count : capacity * 2;						\
+	name##_elem *heap = (name##_elem*)realloc(queue->heap, (size_t)capacity * sizeof(name##_elem));		\
+	if(heap == NULL) {												\
+		printf("Could not grow queue.\n");									\
+		return -1;												\
+	}														\
+	queue->heap = heap;												\
+	queue->capacity = capacity;											\
+	return 0;													\
+}															\
+															\
+/* insert a copy of payload; returns 0 on success, -1 if there was no room */					\
+static inline int name##_offer(name *queue, int priority, type payload)					\
+{															\
+	if(queue->size == queue->capacity && name##_reserve(queue, queue->size + 1) != 0)			\
+		return -1;												\
+															\
+	/* walk the hole up from the bottom, shifting parents down, and write the element once where it stops */	\
+	name##_elem moving;												\
+	moving.priority = priority;											\
+	moving.seq = queue->next_seq++;											\
+	moving.payload = payload;											\
+															\
+	int i = queue->size++;												\
+	while(i > 0) {													\
+		int parent = (i - 1) / PQUEUE_GENERIC_ARITY;								\
+		if(!name##_comes_before(&moving, &queue->heap[parent]))						\
+			break;												\
+		queue->heap[i] = queue->heap[parent];									\
+		i = parent;												\
+	}														\
+	queue->heap[i] = moving;											\
+	return 0;													\
+}															\
+															\
+/* pointer to the payload of the first element, valid until the queue changes; NULL if empty */		\
+static inline type* name##_peek(name *queue)									\
+{															\
+	return queue->size ? &queue->heap[0].payload : NULL;								\
+}															\
+															\
+/* remove the first element, copying its payload (and priority) out if the pointers aren't NULL; */		\
+/* returns 1 if there was an element, 0 if the queue is empty */						\
+static inline int name##_poll(name *queue, int *priority, type *payload)					\
+{															\
+	if(queue->size == 0)												\
+		return 0;												\
+	if(priority != NULL)												\
+		*priority = queue->heap[0].priority;									\
+	if(payload != NULL)												\
+		*payload = queue->heap[0].payload;									\
+															\
+	/* sift the former last element down from the root */							\
+	int size = --queue->size;											\
+	if(size == 0)													\
+		return 1;												\
+	name##_elem moving = queue->heap[size];										\
+	int i = 0;													\
+	while(1) {													\
+		int first = PQUEUE_GENERIC_ARITY * i + 1;								\
+		if(first >= size)											\
+			break;												\
+		int last = first + PQUEUE_GENERIC_ARITY < size ? first + PQUEUE_GENERIC_ARITY : size;		\
+		int best = first;											\
+		for(int c = first + 1; c < last; c++) {									\
+			if(name##_comes_before(&queue->heap[c], &queue->heap[best]))					\
+				best = c;										\
+		}													\
+		if(!name##_comes_before(&queue->heap[best], &moving))							\
+			break;												\
+		queue->heap[i] = queue->heap[best];									\
+		i = best;												\
+	}														\
+	queue->heap[i] = moving;											\
+	return 1;													\
+}															\
+															\
+static inline int name##_size(name *queue)									\
+{															\
+	return queue->size;												\
+}
+
+#endif
@@ -0,0 +1,232 @@
+#include "PrioQueue.h"
+#include "PrioQueue_mt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+				/** Concurrent Priority Queue **/
+/** A "multi-queue": the elements are spread over several independently locked PrioQueue shards. **/
+/** Offers go to a random shard; polls look at the top priority of two random shards and take from the better one. **/
+/** Threads rarely meet on the same lock, so throughput grows with the number of workers instead of queueing on one mutex. **/
+
+#define PQUEUE_MT_CACHE_LINE 64
+#define PQUEUE_MT_ATTEMPTS 8		//random tries before offer blocks on a lock, or poll falls back to sweeping every shard
+
+typedef struct
+{
+	_Alignas(PQUEUE_MT_CACHE_LINE) pthread_mutex_t lock;	//each shard gets its own cache line(s), so neighbouring locks don't share one
+	PrioQueue *queue;
+	atomic_int count;	//number of elements in queue, and the priority of its first element;
+	atomic_int top;		//both are kept up to date under lock, but may be read without it to choose a shard
+} shard;
+
+struct PrioQueueMT
+{
+	int shards;		//how many shards there are
+	shard *shard;
+	atomic_int size;	//how many elements are in the queue, across all shards
+};
+
+/** Per-thread xorshift generator for picking shards; seeded from the address of the thread's own state **/
+static unsigned int next_random(void)
+{
+	static _Thread_local unsigned int state = 0;
+
+	if(state == 0)
+		state = (unsigned int)((uintptr_t)&state * 2654435761u) | 1;
+
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+static shard* random_shard(PrioQueueMT *queue)
+{
+	return &queue->shard[next_random() % queue->shards];
+}
+
+/** Refresh the lock-free view of a shard after its queue changed; caller holds the shard's lock **/
+static void publish(shard *s)
+{
+	int priority;
+
+	if(pqueue_try_peek(s->queue, &priority, NULL))
+		atomic_store_explicit(&s->top, priority, memory_order_relaxed);
+
+	atomic_store_explicit(&s->count, pqueue_size(s->queue), memory_order_release);
+}
+
+/** Of two shards, the one whose first element has the higher priority; NULL if both look empty **/
+static shard* better_shard(shard *a, shard *b)
+{
+	int a_full = atomic_load_explicit(&a->count, memory_order_acquire) > 0;
+	int b_full = atomic_load_explicit(&b->count, memory_order_acquire) > 0;
+
+	if(!a_full)
+		return b_full ? b : NULL;
+	if(!b_full)
+		return a;
+
+	return atomic_load_explicit(&a->top, memory_order_relaxed) >= atomic_load_explicit(&b->top, memory_order_relaxed) ? a : b;
+}
+
+/** Poll the given shard, if there is still something in it by the time we hold its lock **/
+static int poll_shard(PrioQueueMT *queue, shard *s, int *priority, int *value)
+{
+	int got = pqueue_try_poll(s->queue, priority, value);
+
+	publish(s);
+	pthread_mutex_unlock(&s->lock);
+
+	if(got)
+		atomic_fetch_sub_explicit(&queue->size, 1, memory_order_relaxed);
+	return got;
+}
+
+/** Create queue **/
+PrioQueueMT* pqueue_mt_new(int shards)
+{
+	if(shards <= 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		shards = 2 * (cpus > 0 ? (int)cpus : 1);	//more shards than threads keeps two random picks from colliding often
+	}
+
+	PrioQueueMT *queue = (PrioQueueMT*)malloc(sizeof(PrioQueueMT));
+	if(queue == NULL)
+		return NULL;
+
+	queue->shard = (shard*)aligned_alloc(PQUEUE_MT_CACHE_LINE, shards * sizeof(shard));
+	if(queue->shard == NULL) {
+		free(queue);
+		return NULL;
+	}
+
+	queue->shards = shards;
+	atomic_init(&queue->size, 0);
+
+	for(int i = 0; i < shards; i++) {
+		shard *s = &queue->shard[i];
+
+		pthread_mutex_init(&s->lock, NULL);
+		s->queue = pqueue_new();
+		atomic_init(&s->count, 0);
+		atomic_init(&s->top, 0);
+
+		if(s->queue == NULL) {
+			queue->shards = i + 1;		//only free what we've set up so far
+			pqueue_mt_free(queue);
+			return NULL;
+		}
+	}
+
+	return queue;
+}
+
+/** Delete entire queue; no other thread may be using it anymore **/
+void pqueue_mt_free(PrioQueueMT *queue)
+{
+	if(queue == NULL) {
+		puts("Given queue is uninitialized.");
+		return;
+	}
+
+	for(int i = 0; i < queue->shards; i++) {
+		if(queue->shard[i].queue != NULL)
+			pqueue_free(queue->shard[i].queue);
+		pthread_mutex_destroy(&queue->shard[i].lock);
+	}
+
+	free(queue->shard);
+	free(queue);
+}
+
+/** Insert value into a random shard, preferring one whose lock nobody holds right now **/
+/** returns 0 on success, -1 if there was no room (there are no handles as with PrioQueue) **/
+int pqueue_mt_offer(PrioQueueMT *queue, int priority, int value)
+{
+	shard *s;
+
+	for(int attempt = 0; ; attempt++) {
+		s = random_shard(queue);
+
+		if(pthread_mutex_trylock(&s->lock) == 0)
+			break;
+
+		if(attempt == PQUEUE_MT_ATTEMPTS) {		//everything we tried was busy, so just wait for the last one
+			pthread_mutex_lock(&s->lock);
+			break;
+		}
+	}
+
+	//pqueue_offer returns a handle, or -1 if there was no room; the handle is of no use outside the shard's lock
+	int added = pqueue_offer(s->queue, priority, value) >= 0;
+
+	publish(s);
+	pthread_mutex_unlock(&s->lock);
+
+	if(!added)
+		return -1;
+
+	atomic_fetch_add_explicit(&queue->size, 1, memory_order_relaxed);
+	return 0;
+}
+
+/** Remove an element of (nearly) highest priority without ever blocking on a lock **/
+/** returns 1 and fills in priority and value (either may be NULL) on success, 0 if nothing was taken: the queue **/
+/** is empty, or every shard holding something was busy during one sweep over them all (pqueue_mt_size tells which) **/
+int pqueue_mt_try_poll(PrioQueueMT *queue, int *priority, int *value)
+{
+	for(int attempt = 0; attempt < PQUEUE_MT_ATTEMPTS; attempt++) {
+
+		if(atomic_load_explicit(&queue->size, memory_order_relaxed) == 0)
+			return 0;
+
+		shard *s = better_shard(random_shard(queue), random_shard(queue));
+
+		if(s == NULL || pthread_mutex_trylock(&s->lock) != 0)
+			continue;	//both picks empty, or someone else is on it: pick again
+
+		if(poll_shard(queue, s, priority, value))
+			return 1;
+	}
+
+	//the random picks kept missing, e.g. because only a few shards hold anything. sweep all of them once, skipping
+	//the ones someone else is on; if those were the only ones holding anything, give up rather than spin on them
+	int start = next_random() % queue->shards;
+
+	for(int i = 0; i < queue->shards; i++) {
+		shard *s = &queue->shard[(start + i) % queue->shards];
+
+		if(atomic_load_explicit(&s->count, memory_order_acquire) == 0)
+			continue;
+
+		if(pthread_mutex_trylock(&s->lock) != 0)
+			continue;
+
+		if(poll_shard(queue, s, priority, value))
+			return 1;
+	}
+
+	return 0;
+}
+
+/** Remove element of (nearly) highest priority and return its value, -1 if nothing was taken (see pqueue_mt_try_poll) **/
+int pqueue_mt_poll(PrioQueueMT *queue)
+{
+	int value;
+
+	if(pqueue_mt_try_poll(queue, NULL, &value))
+		return value;
+
+	return -1;
+}
+
+/** Return size of queue; only a snapshot while other threads are working on it **/
+int pqueue_mt_size(PrioQueueMT *queue)
+{
+	return atomic_load_explicit(&queue->size, memory_order_relaxed);
+}
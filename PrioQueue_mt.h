@@ -0,0 +1,18 @@
+#ifndef PRIOQUEUE_MT_H
+#define PRIOQUEUE_MT_H
+
+/** Thread-safe priority queue for many workers pulling from one pool of jobs **/
+/** Same value/priority semantics as PrioQueue, but ordering is relaxed: a poll returns one of the highest-priority **/
+/** elements with high probability rather than always the very highest, and equal priorities are not strictly FIFO **/
+
+typedef struct PrioQueueMT PrioQueueMT;
+
+PrioQueueMT* pqueue_mt_new(int shards);		//shards <= 0 picks two shards per online CPU
+void pqueue_mt_free(PrioQueueMT *queue);
+
+int pqueue_mt_offer(PrioQueueMT *queue, int priority, int value);
+int pqueue_mt_poll(PrioQueueMT *queue);
+int pqueue_mt_try_poll(PrioQueueMT *queue, int *priority, int *value);
+int pqueue_mt_size(PrioQueueMT *queue);
+
+#endif
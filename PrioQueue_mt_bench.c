@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "PrioQueue.h"
+#include "PrioQueue_mt.h"
+
+				/** Contention benchmark: one mutex around a PrioQueue vs. the sharded PrioQueueMT **/
+/** Every worker alternates offer and poll on a shared, prefilled queue; prints one CSV line per variant and thread count **/
+
+#define PREFILL 100000
+
+typedef struct
+{
+	int variant;		//0 = global mutex around PrioQueue, 1 = PrioQueueMT
+	long ops;		//offer/poll pairs per worker
+	unsigned int seed;
+	pthread_barrier_t *start;
+} worker_args;
+
+static PrioQueue *g_queue;
+static pthread_mutex_t g_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static PrioQueueMT *g_mt_queue;
+
+static double now_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void *worker(void *arg)
+{
+	worker_args *args = (worker_args*)arg;
+	unsigned int seed = args->seed;
+
+	pthread_barrier_wait(args->start);
+
+	for(long i = 0; i < args->ops; i++) {
+		int priority = rand_r(&seed) % 1024;
+
+		if(args->variant == 0) {
+			pthread_mutex_lock(&g_queue_mutex);
+			pqueue_offer(g_queue, priority, (int)i);
+			pthread_mutex_unlock(&g_queue_mutex);
+
+			pthread_mutex_lock(&g_queue_mutex);
+			pqueue_poll(g_queue);
+			pthread_mutex_unlock(&g_queue_mutex);
+		}
+		else {
+			pqueue_mt_offer(g_mt_queue, priority, (int)i);
+			pqueue_mt_poll(g_mt_queue);
+		}
+	}
+
+	return NULL;
+}
+
+/** Run one variant with the given number of workers and return the elapsed wall time in seconds **/
+double run(int variant, int threads, long ops)
+{
+	pthread_t thread[threads];
+	worker_args args[threads];
+	pthread_barrier_t start;
+	unsigned int seed = 42;
+
+	if(variant == 0) {
+		g_queue = pqueue_new();
+		pqueue_reserve(g_queue, PREFILL + threads);
+		for(int i = 0; i < PREFILL; i++)
+			pqueue_offer(g_queue, rand_r(&seed) % 1024, i);
+	}
+	else {
+		g_mt_queue = pqueue_mt_new(0);
+		for(int i = 0; i < PREFILL; i++)
+			pqueue_mt_offer(g_mt_queue, rand_r(&seed) % 1024, i);
+	}
+
+	pthread_barrier_init(&start, NULL, threads + 1);
+
+	for(int t = 0; t < threads; t++) {
+		args[t] = (worker_args) { variant, ops, 1000u + t, &start };
+		pthread_create(&thread[t], NULL, worker, &args[t]);
+	}
+
+	pthread_barrier_wait(&start);		//let everyone go at once, then start the clock
+	double begin = now_seconds();
+
+	for(int t = 0; t < threads; t++)
+		pthread_join(thread[t], NULL);
+
+	double elapsed = now_seconds() - begin;
+
+	pthread_barrier_destroy(&start);
+	if(variant == 0)
+		pqueue_free(g_queue);
+	else
+		pqueue_mt_free(g_mt_queue);
+
+	return elapsed;
+}
+
+int main(int argc, char** argv) {
+
+	if (argc > 3) {
+		printf("Usage: pqueue_mt_bench [MAXTHREADS] [OPS_PER_THREAD]\n");
+		return EXIT_FAILURE;
+	}
+
+	int max_threads = (argc > 1) ? (int)strtol(argv[1], NULL, 10) : 16;
+	long ops = (argc > 2) ? strtol(argv[2], NULL, 10) : 200000;
+
+	printf("variant,threads,ops,seconds,mops_per_sec\n");
+
+	for(int threads = 1; threads <= max_threads; threads *= 2) {
+		for(int variant = 0; variant < 2; variant++) {
+
+			double seconds = run(variant, threads, ops);
+			long total = 2 * ops * threads;		//an offer and a poll per iteration
+
+			printf("%s,%d,%ld,%.4f,%.3f\n", variant ? "sharded" : "mutex", threads, total,
+				seconds, total / seconds / 1e6);
+		}
+	}
+
+	return 0;
+}
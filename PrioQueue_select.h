@@ -0,0 +1,31 @@
+#ifndef PRIOQUEUE_SELECT_H
+#define PRIOQUEUE_SELECT_H
+
+/** Include this instead of PrioQueue.h to pick the queue engine at compile time. **/
+/** By default it is the comparison-based PrioQueue; building with -DPQUEUE_USE_BUCKETS=<levels> swaps in **/
+/** the BucketQueue with that many priority levels. Only the calls both engines share are mapped. **/
+
+#ifdef PQUEUE_USE_BUCKETS
+
+#include "BucketQueue.h"
+
+#define PrioQueue		BucketQueue
+#define pqueue_new()		bqueue_new(PQUEUE_USE_BUCKETS)
+#define pqueue_free		bqueue_free
+#define pqueue_offer		bqueue_offer
+#define pqueue_peek		bqueue_peek
+#define pqueue_poll		bqueue_poll
+#define pqueue_peek_last	bqueue_peek_last
+#define pqueue_poll_last	bqueue_poll_last
+#define pqueue_get_last		bqueue_poll_last
+#define pqueue_try_peek		bqueue_try_peek
+#define pqueue_try_poll		bqueue_try_poll
+#define pqueue_size		bqueue_size
+
+#else
+
+#include "PrioQueue.h"
+
+#endif
+
+#endif
@@ -0,0 +1,325 @@
+#include "banker.h"
+#include "resvec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+				/** Banker's Algorithm for many threads and resource types **/
+/** The safety check finds threads whose whole need fits into what's free, lets them finish and return what they **/
+/** hold, and repeats. Instead of rescanning every thread after each finish, it keeps the threads sorted by their need **/
+/** of each resource: every resource has a cursor into its sorted list that only ever moves forward as the free pool **/
+/** grows, and a thread goes on the worklist once all of its resources' cursors have passed it. **/
+/** A check costs O(threads * resources); keeping the lists sorted costs a few moves per allocation. **/
+/** Once a state is known to be safe, a grant that leaves the thread able to finish straight away keeps it safe (it can **/
+/** go first and return at least what it got), so most requests are settled by one vector compare of its need row **/
+/** against what's free. Rows are padded and aligned for the resvec kernels. **/
+
+struct banker
+{
+	int threads;
+	int resources;
+	int stride;		//resources, padded out to whole vector registers; the padding is always 0
+	unsigned *available;	//f: free units of each resource
+	unsigned *allocated;	//B: allocated[t * stride + r] units of r are held by t
+	unsigned *need;		//R: need[t * stride + r] more units of r may still be asked for by t
+	int *order;		//order[r * threads ...]: the threads, sorted by their need of resource r
+	int *rank;		//rank[r * threads + t]: where thread t is in resource r's order
+
+	//scratch space for the safety check
+	unsigned *work;		//what would be free after the threads finished so far
+	int *cursor;		//how far into its order each resource has been walked
+	int *satisfied;		//for how many resources each thread's need fits into work
+	int *ready;		//worklist of threads whose whole need fits
+
+	int known_safe;		//the state has been checked safe, and only grants that were checked or releases happened since
+	int vetted;		//the last check said granting vetted_units of vetted_r to vetted_t is safe
+	int vetted_t, vetted_r;
+	unsigned vetted_units;
+};
+
+#define NEED(b, t, r) ((b)->need[(size_t)(t) * (b)->stride + (r)])
+#define ALLOCATED(b, t, r) ((b)->allocated[(size_t)(t) * (b)->stride + (r)])
+
+banker* banker_new(int threads, int resources)
+{
+	if(threads < 1 || resources < 1) {
+		printf("Need at least one thread and one resource.\n");
+		return NULL;
+	}
+
+	banker *b = (banker*)calloc(1, sizeof(banker));
+	if(b == NULL)
+		return NULL;
+
+	size_t cells = (size_t)threads * resources;
+
+	b->threads = threads;
+	b->resources = resources;
+	b->stride = resvec_padded(resources);
+	b->available = resvec_alloc(b->stride);
+	b->allocated = resvec_alloc(threads * b->stride);
+	b->need = resvec_alloc(threads * b->stride);
+	b->order = (int*)malloc(cells * sizeof(int));
+	b->rank = (int*)malloc(cells * sizeof(int));
+	b->work = resvec_alloc(b->stride);
+	b->cursor = (int*)malloc(resources * sizeof(int));
+	b->satisfied = (int*)malloc(threads * sizeof(int));
+	b->ready = (int*)malloc(threads * sizeof(int));
+
+	if(!b->available || !b->allocated || !b->need || !b->order || !b->rank || !b->work || !b->cursor || !b->satisfied || !b->ready) {
+		banker_free(b);
+		return NULL;
+	}
+
+	//nothing is held or needed, which is safe; and every need starts out 0, so any order is sorted
+	b->known_safe = 1;
+	for(int r = 0; r < resources; r++) {
+		for(int t = 0; t < threads; t++) {
+			b->order[(size_t)r * threads + t] = t;
+			b->rank[(size_t)r * threads + t] = t;
+		}
+	}
+
+	return b;
+}
+
+void banker_free(banker *b)
+{
+	if(b == NULL)
+		return;
+
+	free(b->available);
+	free(b->allocated);
+	free(b->need);
+	free(b->order);
+	free(b->rank);
+	free(b->work);
+	free(b->cursor);
+	free(b->satisfied);
+	free(b->ready);
+	free(b);
+}
+
+/** A new banker in the same state as b **/
+banker* banker_clone(const banker *b)
+{
+	banker *copy = banker_new(b->threads, b->resources);
+	if(copy != NULL)
+		banker_copy(copy, b);
+	return copy;
+}
+
+/** Put dst into the same state as src; both must have as many threads and resources **/
+void banker_copy(banker *dst, const banker *src)
+{
+	size_t cells = (size_t)src->threads * src->resources;
+	size_t rows = (size_t)src->threads * src->stride;
+
+	memcpy(dst->available, src->available, src->stride * sizeof(unsigned));
+	memcpy(dst->allocated, src->allocated, rows * sizeof(unsigned));
+	memcpy(dst->need, src->need, rows * sizeof(unsigned));
+	memcpy(dst->order, src->order, cells * sizeof(int));
+	memcpy(dst->rank, src->rank, cells * sizeof(int));
+
+	dst->known_safe = src->known_safe;
+	dst->vetted = 0;
+}
+
+int banker_threads(const banker *b)
+{
+	return b->threads;
+}
+
+int banker_resources(const banker *b)
+{
+	return b->resources;
+}
+
+/** Move thread t to its place in resource r's order after its need of r changed **/
+static void reposition(banker *b, int t, int r)
+{
+	int *order = b->order + (size_t)r * b->threads;
+	int *rank = b->rank + (size_t)r * b->threads;
+	unsigned key = NEED(b, t, r);
+	int i = rank[t];
+
+	while(i > 0 && NEED(b, order[i - 1], r) > key) {
+		order[i] = order[i - 1];
+		rank[order[i]] = i;
+		i--;
+	}
+
+	while(i < b->threads - 1 && NEED(b, order[i + 1], r) < key) {
+		order[i] = order[i + 1];
+		rank[order[i]] = i;
+		i++;
+	}
+
+	order[i] = t;
+	rank[t] = i;
+}
+
+/** Setting any part of the state directly means it has to be checked in full again **/
+static void forget_checks(banker *b)
+{
+	b->known_safe = 0;
+	b->vetted = 0;
+}
+
+void banker_set_available(banker *b, int r, unsigned units)
+{
+	b->available[r] = units;
+	forget_checks(b);
+}
+
+void banker_set_allocated(banker *b, int t, int r, unsigned units)
+{
+	ALLOCATED(b, t, r) = units;
+	forget_checks(b);
+}
+
+void banker_set_need(banker *b, int t, int r, unsigned units)
+{
+	NEED(b, t, r) = units;
+	reposition(b, t, r);
+	forget_checks(b);
+}
+
+unsigned banker_available(const banker *b, int r)
+{
+	return b->available[r];
+}
+
+unsigned banker_allocated(const banker *b, int t, int r)
+{
+	return ALLOCATED(b, t, r);
+}
+
+/** What t holds of each resource, padded and aligned for the resvec kernels **/
+const unsigned* banker_allocated_row(const banker *b, int t)
+{
+	return &ALLOCATED(b, t, 0);
+}
+
+static void take(banker *b, int t, int r, unsigned units)
+{
+	b->available[r] -= units;
+	ALLOCATED(b, t, r) += units;
+	NEED(b, t, r) -= units;
+	reposition(b, t, r);
+}
+
+/** Grant units of r to t: they leave the free pool, t holds them and needs that many less **/
+/** the state is known safe afterwards if this is the grant banker_allocation_is_safe just said was **/
+void banker_allocate(banker *b, int t, int r, unsigned units)
+{
+	b->known_safe = b->vetted && b->vetted_t == t && b->vetted_r == r && b->vetted_units == units;
+	b->vetted = 0;
+	take(b, t, r, units);
+}
+
+/** Grant units of r to t that are known to leave the state safe **/
+void banker_grant(banker *b, int t, int r, unsigned units)
+{
+	take(b, t, r, units);
+	b->known_safe = 1;
+	b->vetted = 0;
+}
+
+/** Giving units back never makes a safe state unsafe, nor a safe grant unsafe **/
+void banker_release(banker *b, int t, int r, unsigned units)
+{
+	b->available[r] += units;
+	ALLOCATED(b, t, r) -= units;
+}
+
+/** Walk resource r's order as far as work allows, putting threads that now fit entirely on the worklist **/
+static void advance(banker *b, int r, int *ready_count)
+{
+	const int *order = b->order + (size_t)r * b->threads;
+
+	while(b->cursor[r] < b->threads) {
+		int t = order[b->cursor[r]];
+		if(NEED(b, t, r) > b->work[r])
+			break;
+
+		b->cursor[r]++;
+		if(++b->satisfied[t] == b->resources)
+			b->ready[(*ready_count)++] = t;
+	}
+}
+
+/** Is there an order in which every thread can get all it still needs, finish, and give back what it holds? **/
+/** returns 1 if so (the state is safe), 0 if not **/
+int banker_is_safe(banker *b)
+{
+	int finished = 0, ready_count = 0;
+
+	memcpy(b->work, b->available, b->resources * sizeof(unsigned));
+	memset(b->satisfied, 0, b->threads * sizeof(int));
+
+	for(int r = 0; r < b->resources; r++) {
+		b->cursor[r] = 0;
+		advance(b, r, &ready_count);
+	}
+
+	while(ready_count > 0) {
+
+		int t = b->ready[--ready_count];
+		const unsigned *held = &ALLOCATED(b, t, 0);
+		finished++;
+
+		//t finishes and gives everything back, which may let more threads through on those resources
+		resvec_add(b->work, held, b->stride);
+		for(int r = 0; r < b->resources; r++) {
+			if(held[r] != 0)
+				advance(b, r, &ready_count);
+		}
+	}
+
+	return finished == b->threads;
+}
+
+/** Would granting units of r to t leave the state safe? returns 1 if so, 0 if not or if there aren't enough free units **/
+/** the state is the same afterwards either way **/
+int banker_allocation_is_safe(banker *b, int t, int r, unsigned units)
+{
+	if(units > b->available[r])
+		return 0;
+
+	if(units > NEED(b, t, r)) {
+		printf("T%d asks for %u units of resource %d but only declared %u more.\n", t + 1, units, r, NEED(b, t, r));
+		return 0;
+	}
+
+	int safe = 0;
+
+	if(b->known_safe) {
+		//can t finish right after the grant, with what would be left? then it's safe
+		b->available[r] -= units;
+		NEED(b, t, r) -= units;
+		safe = resvec_all_le(&NEED(b, t, 0), b->available, b->stride);
+		b->available[r] += units;
+		NEED(b, t, r) += units;
+	}
+
+	if(!safe) {
+		take(b, t, r, units);
+		safe = banker_is_safe(b);
+
+		//take it back
+		b->available[r] += units;
+		ALLOCATED(b, t, r) -= units;
+		NEED(b, t, r) += units;
+		reposition(b, t, r);
+	}
+
+	if(safe) {
+		b->vetted = 1;
+		b->vetted_t = t;
+		b->vetted_r = r;
+		b->vetted_units = units;
+	}
+
+	return safe;
+}
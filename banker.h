@@ -0,0 +1,33 @@
+#ifndef BANKER_H
+#define BANKER_H
+
+/** Banker's algorithm state for any number of threads and resource types, sized at runtime **/
+/** available (f), allocated (B) and need (R) each live in one contiguous array, a row of resources per thread. **/
+/** Need is what a thread may still ask for; as in deadlock.c, releasing units gives them back to available only. **/
+
+typedef struct banker banker;
+
+banker* banker_new(int threads, int resources);
+void banker_free(banker *b);
+banker* banker_clone(const banker *b);
+void banker_copy(banker *dst, const banker *src);
+
+int banker_threads(const banker *b);
+int banker_resources(const banker *b);
+
+void banker_set_available(banker *b, int r, unsigned units);
+void banker_set_allocated(banker *b, int t, int r, unsigned units);
+void banker_set_need(banker *b, int t, int r, unsigned units);
+
+unsigned banker_available(const banker *b, int r);
+unsigned banker_allocated(const banker *b, int t, int r);
+const unsigned* banker_allocated_row(const banker *b, int t);
+
+void banker_allocate(banker *b, int t, int r, unsigned units);
+void banker_grant(banker *b, int t, int r, unsigned units);
+void banker_release(banker *b, int t, int r, unsigned units);
+
+int banker_is_safe(banker *b);
+int banker_allocation_is_safe(banker *b, int t, int r, unsigned units);
+
+#endif
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "banker.h"
+#include "banker_mt.h"
+
+				/** Contention benchmark: the safety check under one mutex vs. the optimistic banker_mt **/
+/** Every worker is a thread of the banker. It declares a random claim, asks for it one unit at a time, and gives **/
+/** everything back once it has it all or a request turns out unsafe. Prints one CSV line per variant and thread count. **/
+
+#define MAX_CLAIM 2		//a worker claims up to this many units of each resource
+
+typedef struct
+{
+	int variant;		//0 = safety check under the mutex, 1 = banker_mt
+	int t;			//the worker's thread number in the banker
+	int resources;
+	long requests;		//allocation requests per worker
+	long granted;		//how many of them were granted
+	pthread_barrier_t *start;
+} worker_args;
+
+static banker *g_banker;
+static banker_mt *g_banker_mt;
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static double now_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int request(int variant, int t, int r)
+{
+	int granted;
+
+	pthread_mutex_lock(&g_mutex);
+	if(variant == 0) {
+		granted = banker_allocation_is_safe(g_banker, t, r, 1);
+		if(granted)
+			banker_allocate(g_banker, t, r, 1);
+	}
+	else
+		granted = banker_mt_allocate(g_banker_mt, t, r, 1);
+	pthread_mutex_unlock(&g_mutex);
+
+	return granted;
+}
+
+/** Give back what is held, and declare a new claim **/
+static void restart(int variant, int t, int resources, unsigned *held, unsigned *need, unsigned int *seed)
+{
+	pthread_mutex_lock(&g_mutex);
+	for(int r = 0; r < resources; r++) {
+		need[r] = rand_r(seed) % (MAX_CLAIM + 1);
+		if(variant == 0) {
+			banker_release(g_banker, t, r, held[r]);
+			banker_set_need(g_banker, t, r, need[r]);
+		}
+		else {
+			banker_mt_release(g_banker_mt, t, r, held[r]);
+			banker_mt_set_need(g_banker_mt, t, r, need[r]);
+		}
+		held[r] = 0;
+	}
+	pthread_mutex_unlock(&g_mutex);
+}
+
+void *worker(void *arg)
+{
+	worker_args *args = (worker_args*)arg;
+	int m = args->resources;
+	unsigned *held = (unsigned*)calloc(m, sizeof(unsigned));
+	unsigned *need = (unsigned*)calloc(m, sizeof(unsigned));
+	unsigned int seed = 1000u + args->t;
+	int r = 0;
+
+	pthread_barrier_wait(args->start);
+
+	long made = 0;
+	while(made < args->requests) {
+
+		//next resource still needed; a worker that has its whole claim starts over
+		int left = m;
+		while(left > 0 && need[r] == 0) {
+			r = (r + 1) % m;
+			left--;
+		}
+
+		if(left == 0) {
+			restart(args->variant, args->t, m, held, need, &seed);
+			continue;
+		}
+
+		made++;
+		if(!request(args->variant, args->t, r)) {
+			restart(args->variant, args->t, m, held, need, &seed);
+			continue;
+		}
+
+		args->granted++;
+		held[r]++;
+		need[r]--;
+	}
+
+	restart(args->variant, args->t, m, held, need, &seed);
+
+	free(held);
+	free(need);
+	return NULL;
+}
+
+/** Run one variant with the given number of workers; returns the elapsed wall time in seconds and adds up the grants **/
+double run(int variant, int threads, int resources, long requests, long *granted, long *conflicts)
+{
+	pthread_t thread[threads];
+	worker_args args[threads];
+	pthread_barrier_t start;
+
+	//on average a worker claims one unit of each resource, and there is one for each; never fewer than one claim
+	//can take, so a worker on its own always gets through
+	g_banker = banker_new(threads, resources);
+	for(int r = 0; r < resources; r++)
+		banker_set_available(g_banker, r, threads < MAX_CLAIM ? MAX_CLAIM : threads);
+
+	if(variant == 1)
+		g_banker_mt = banker_mt_new(g_banker, &g_mutex);
+
+	pthread_barrier_init(&start, NULL, threads + 1);
+
+	for(int t = 0; t < threads; t++) {
+		args[t] = (worker_args) { variant, t, resources, requests, 0, &start };
+		pthread_create(&thread[t], NULL, worker, &args[t]);
+	}
+
+	pthread_barrier_wait(&start);		//let everyone go at once, then start the clock
+	double begin = now_seconds();
+
+	for(int t = 0; t < threads; t++)
+		pthread_join(thread[t], NULL);
+
+	double elapsed = now_seconds() - begin;
+
+	*granted = 0;
+	for(int t = 0; t < threads; t++)
+		*granted += args[t].granted;
+	*conflicts = variant ? banker_mt_conflicts(g_banker_mt) : 0;
+
+	pthread_barrier_destroy(&start);
+	banker_mt_free(g_banker_mt);
+	g_banker_mt = NULL;
+	banker_free(g_banker);
+
+	return elapsed;
+}
+
+int main(int argc, char** argv) {
+
+	if (argc > 4) {
+		printf("Usage: banker_bench [MAXTHREADS] [REQUESTS_PER_THREAD] [RESOURCES]\n");
+		return EXIT_FAILURE;
+	}
+
+	int max_threads = (argc > 1) ? (int)strtol(argv[1], NULL, 10) : 16;
+	long requests = (argc > 2) ? strtol(argv[2], NULL, 10) : 100000;
+	int resources = (argc > 3) ? (int)strtol(argv[3], NULL, 10) : 64;
+
+	if(max_threads < 1 || requests < 1 || resources < 1) {
+		printf("Usage: banker_bench [MAXTHREADS] [REQUESTS_PER_THREAD] [RESOURCES]\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("variant,threads,resources,requests,granted,conflicts,seconds,krequests_per_sec\n");
+
+	for(int threads = 1; threads <= max_threads; threads *= 2) {
+		for(int variant = 0; variant < 2; variant++) {
+
+			long granted, conflicts;
+			double seconds = run(variant, threads, resources, requests, &granted, &conflicts);
+			long total = requests * threads;
+
+			printf("%s,%d,%d,%ld,%ld,%ld,%.4f,%.1f\n", variant ? "optimistic" : "mutex", threads, resources,
+				total, granted, conflicts, seconds, total / seconds / 1e3);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,191 @@
+#include "banker_mt.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+				/** Optimistic Banker **/
+/** The state has a version, the number of changes made to it, and a log of the last BANKER_MT_LOG changes. **/
+/** A snapshot catches up by replaying the log from its own version, so taking one under the lock costs a few **/
+/** updates instead of a copy of the whole state; only a snapshot that fell off the end of the log is copied. **/
+/** On commit the log since the snapshot decides whether its answer still holds: **/
+/**	nothing changed:	it does, safe or not **/
+/**	only releases:		"safe" does (more free units and less held never make a safe state unsafe), "unsafe" may not **/
+/**	anything else:		it may not; take a new snapshot and check again **/
+/** After BANKER_MT_ATTEMPTS conflicts in a row the check runs under the lock, so a busy state can't starve a request. **/
+
+#define BANKER_MT_LOG 256
+#define BANKER_MT_ATTEMPTS 4
+
+enum { ALLOCATE, RELEASE, SET_NEED };
+
+typedef struct
+{
+	int op;
+	int t;
+	int r;
+	unsigned units;
+} change;
+
+struct banker_mt
+{
+	banker *state;			//the shared state
+	pthread_mutex_t *lock;		//guards state, version and log
+	unsigned long version;		//how many changes have been made to state
+	change log[BANKER_MT_LOG];	//log[v % BANKER_MT_LOG] took state from version v to v + 1
+	banker **snapshot;		//one per thread, for checks outside the lock
+	unsigned long *seen;		//the version each snapshot is at
+	long conflicts;			//checks that had to be repeated
+};
+
+banker_mt* banker_mt_new(banker *state, pthread_mutex_t *lock)
+{
+	int threads = banker_threads(state);
+
+	banker_mt *m = (banker_mt*)calloc(1, sizeof(banker_mt));
+	if(m == NULL)
+		return NULL;
+
+	m->state = state;
+	m->lock = lock;
+	m->snapshot = (banker**)calloc(threads, sizeof(banker*));
+	m->seen = (unsigned long*)calloc(threads, sizeof(unsigned long));
+
+	if(!m->snapshot || !m->seen) {
+		banker_mt_free(m);
+		return NULL;
+	}
+
+	for(int t = 0; t < threads; t++) {
+		m->snapshot[t] = banker_clone(state);
+		if(m->snapshot[t] == NULL) {
+			banker_mt_free(m);
+			return NULL;
+		}
+	}
+
+	return m;
+}
+
+void banker_mt_free(banker_mt *m)
+{
+	if(m == NULL)
+		return;
+
+	if(m->snapshot) {
+		for(int t = 0; t < banker_threads(m->state); t++)
+			banker_free(m->snapshot[t]);
+	}
+
+	free(m->snapshot);
+	free(m->seen);
+	free(m);
+}
+
+static void apply(banker *b, const change *c)
+{
+	switch(c->op) {
+		case ALLOCATE:
+			banker_grant(b, c->t, c->r, c->units);		//every logged grant was checked safe
+			break;
+		case RELEASE:
+			banker_release(b, c->t, c->r, c->units);
+			break;
+		case SET_NEED:
+			banker_set_need(b, c->t, c->r, c->units);
+			break;
+	}
+}
+
+/** Make a change to the shared state and log it **/
+static void record(banker_mt *m, int op, int t, int r, unsigned units)
+{
+	change *c = &m->log[m->version % BANKER_MT_LOG];
+	*c = (change) { op, t, r, units };
+	apply(m->state, c);
+	m->version++;
+}
+
+/** Bring t's snapshot up to the current version **/
+static void refresh(banker_mt *m, int t)
+{
+	banker *snapshot = m->snapshot[t];
+
+	if(m->version - m->seen[t] > BANKER_MT_LOG)
+		banker_copy(snapshot, m->state);
+	else {
+		for(unsigned long v = m->seen[t]; v < m->version; v++)
+			apply(snapshot, &m->log[v % BANKER_MT_LOG]);
+	}
+
+	m->seen[t] = m->version;
+}
+
+/** Does an answer worked out at version from still hold? **/
+static int still_holds(banker_mt *m, unsigned long from, int safe)
+{
+	if(m->version == from)
+		return 1;
+	if(!safe || m->version - from > BANKER_MT_LOG)
+		return 0;
+
+	for(unsigned long v = from; v < m->version; v++) {
+		if(m->log[v % BANKER_MT_LOG].op != RELEASE)
+			return 0;
+	}
+
+	return 1;
+}
+
+/** Grant units of r to t if that leaves the state safe; the lock is dropped while the check runs **/
+/** returns 1 if granted, 0 if not safe (or not enough free units) at the moment **/
+int banker_mt_allocate(banker_mt *m, int t, int r, unsigned units)
+{
+	for(int attempt = 0; attempt < BANKER_MT_ATTEMPTS; attempt++) {
+
+		if(units > banker_available(m->state, r))
+			return 0;
+
+		refresh(m, t);
+		unsigned long from = m->version;
+
+		pthread_mutex_unlock(m->lock);
+		int safe = banker_allocation_is_safe(m->snapshot[t], t, r, units);
+		pthread_mutex_lock(m->lock);
+
+		if(!still_holds(m, from, safe)) {
+			m->conflicts++;
+			continue;
+		}
+
+		if(safe)
+			record(m, ALLOCATE, t, r, units);
+		return safe;
+	}
+
+	//too much going on: check under the lock, like a plain banker
+	return banker_mt_try_allocate(m, t, r, units);
+}
+
+/** Same as banker_mt_allocate, but the check runs on the shared state and the lock is held throughout **/
+int banker_mt_try_allocate(banker_mt *m, int t, int r, unsigned units)
+{
+	if(!banker_allocation_is_safe(m->state, t, r, units))
+		return 0;
+
+	record(m, ALLOCATE, t, r, units);
+	return 1;
+}
+
+void banker_mt_release(banker_mt *m, int t, int r, unsigned units)
+{
+	record(m, RELEASE, t, r, units);
+}
+
+void banker_mt_set_need(banker_mt *m, int t, int r, unsigned units)
+{
+	record(m, SET_NEED, t, r, units);
+}
+
+long banker_mt_conflicts(banker_mt *m)
+{
+	return m->conflicts;
+}
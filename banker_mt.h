@@ -0,0 +1,25 @@
+#ifndef BANKER_MT_H
+#define BANKER_MT_H
+
+#include <pthread.h>
+#include "banker.h"
+
+/** Banker's state shared by many threads, with the safety check run outside the lock **/
+/** Every thread checks its request on its own snapshot of the state while others go on allocating and releasing, **/
+/** then retakes the lock and commits only if nothing that could make the answer wrong happened in the meantime. **/
+/** The lock is the caller's, so it can also guard the caller's own data and be waited on with a condition variable: **/
+/** every function is called, and returns, with it held. All changes to the state have to go through these functions. **/
+
+typedef struct banker_mt banker_mt;
+
+banker_mt* banker_mt_new(banker *state, pthread_mutex_t *lock);
+void banker_mt_free(banker_mt *m);
+
+int banker_mt_allocate(banker_mt *m, int t, int r, unsigned units);
+int banker_mt_try_allocate(banker_mt *m, int t, int r, unsigned units);
+void banker_mt_release(banker_mt *m, int t, int r, unsigned units);
+void banker_mt_set_need(banker_mt *m, int t, int r, unsigned units);
+
+long banker_mt_conflicts(banker_mt *m);
+
+#endif
@@ -12,6 +12,11 @@
 #include "resources.h"
 #include "deadlock.h"
 #include "print.h"
+#include "banker.h"
+#include "waitfor.h"
+#include "waitline.h"
+#include "banker_mt.h"
+#include "resvec.h"
 
 				/** Simulation of Banker's Algorithm **/
 /** Detects deadlock given sequence of process execution **/
@@ -19,8 +24,33 @@
 
 const char LABEL[] = "ABCD";
 
+//with OPTIMISTIC (and AVOIDANCE), allocate_r runs the safety check on its own snapshot of the state, without holding g_state.mutex
+#ifndef OPTIMISTIC
+#define OPTIMISTIC 0
+#endif
+
 Matrix currentNeeds;
 
+//the same state as g_state, sized for any number of threads and resources, for the safety checks. g_state stays what
+//gets printed; allocate_r and release_r update both
+banker *g_banker;
+
+//who is blocked on what; a thread that blocks checks right away whether that closed a deadlock
+waitfor *g_waitfor;
+
+//g_banker shared under g_state.mutex, with a snapshot per thread (OPTIMISTIC only)
+banker_mt *g_banker_mt;
+
+//threads whose request couldn't be granted right away, in the order they asked. While anyone is in it, new requests
+//line up too instead of jumping ahead. A release hands the units straight to every waiter that can now safely have
+//them and wakes just those; nobody wakes up only to find it still can't go
+waitline *g_line;
+pthread_cond_t g_granted_signal[NUM_THREADS];
+
+//threads neither in the line nor finished. Only they can release anything, so once none is left the line is served
+//as it stands: a request that lined up behind an older one would otherwise wait for a release that never comes
+unsigned g_running = NUM_THREADS;
+
 void init_globals(){
 
   /* initialize resource state */
@@ -43,122 +73,83 @@ void init_globals(){
 
 	g_state.B = tmp_B;
 
-  /* initialize mutexes/signals */
+  /* mirror the state for the safety checks */
+  g_banker = banker_new(NUM_THREADS, NUM_RESOURCES);
+  if( !g_banker ){
+    handle_error("banker_new");
+  }
   for(unsigned r=FIRST_RESOURCE; r<NUM_RESOURCES; r++){
-    if( pthread_cond_init (&(g_state.resource_released[r]), NULL) ){
+    banker_set_available(g_banker, r, g_state.f.resource[r]);
+    for(unsigned t=FIRST_THREAD; t<NUM_THREADS; t++){
+      banker_set_allocated(g_banker, t, r, g_state.B.thread[t].resource[r]);
+      banker_set_need(g_banker, t, r, g_state.R.thread[t].resource[r]);
+    }
+  }
+  g_waitfor = waitfor_new(NUM_THREADS, NUM_RESOURCES);
+  if( !g_waitfor ){
+    handle_error("waitfor_new");
+  }
+  g_line = waitline_new(NUM_THREADS);
+  if( !g_line ){
+    handle_error("waitline_new");
+  }
+  # if AVOIDANCE && OPTIMISTIC
+  g_banker_mt = banker_mt_new(g_banker, &(g_state.mutex));
+  if( !g_banker_mt ){
+    handle_error("banker_mt_new");
+  }
+  # endif
+
+  /* initialize mutexes/signals */
+  for(unsigned t=FIRST_THREAD; t<NUM_THREADS; t++){
+    if( pthread_cond_init (&(g_granted_signal[t]), NULL) ){
       handle_error("cond_init");
     }
   }
   if( pthread_mutex_init(&(g_state.mutex), NULL) ){
     handle_error("mutex_init");
   }
-  if( pthread_mutex_init(&g_cfd_mutex, NULL) ){
-    handle_error("mutex_init");
-  }   
-
-  g_checkForDeadlocks = false;
-  # if DETECTION
-  g_checkForDeadlocks = true;
-  # endif
 }
 
-bool vectorEmpty(Vector vector) {
-
-	for(int i = 0; i < NUM_THREADS; i++) {
+//the vector helpers run on the resvec kernels, a few resources per instruction
 
-		if(vector.resource[i] != 0) return false;
-	}
+bool vectorEmpty(Vector vector) {
 
-	return true;
+	return resvec_is_zero(vector.resource, NUM_RESOURCES);
 }
 
 bool allLessEqual(Vector shouldBeLess, Vector shouldBeMore) {
 
-	for(int j = 0; j < NUM_RESOURCES; j++) {
-
-		if(shouldBeLess.resource[j] > shouldBeMore.resource[j]) return false;
-	}
-
-	return true;
+	return resvec_all_le(shouldBeLess.resource, shouldBeMore.resource, NUM_RESOURCES);
 
 }
 
 void addVectors(Vector *v1, Vector *v2) {
 	
-	for(int i = 0; i < NUM_RESOURCES; i++) {
-
-		v1->resource[i] = v1->resource[i] + v2->resource[i];
-	}
+	resvec_add(v1->resource, v2->resource, NUM_RESOURCES);
 }
 
 bool isSafe(unsigned t, unsigned r, unsigned a){
 
-  	bool answer = UNDEFINED;
-	int allocationOk = 0;
-
-	Vector f_copy = g_state.f;
+  	bool answer = UNSAFE;
 
 	char out[57];
 	sprintf(out, "[%d] T%u: is \"allocate(%c, %u)\" safe?",
 		  gettid(), t+1, LABEL[r], a);
 
 	//check if there is enough of resource 'r' available to grant allocation 'a' to thread 't'
-	if(g_state.f.resource[r] >= a) {
-
-		allocationOk = 1;
-		//make temporary allocation for testing purposes
-		f_copy.resource[r] = f_copy.resource[r] - a;
-	}
-
-	else {
-		answer = UNSAFE;
+	if(g_state.f.resource[r] < a) {
 		return answer;
 	}
 
-# if AVOIDANCE
+	answer = SAFE;
 
-	int answerInt = -1;		//"undefined"
-	//int sequenceHolder = 0;
-	Vector done = {{4}};
-
-	for(int i = 0; i < 4; i++) {
-
-			done.resource[i] = false;
-	}
-	
-
-	while(allocationOk && answerInt == -1) {
-
-
-		for(int i = 0; i < 4; i++) {
-
-			if(done.resource[i] == false) {
-
-				if(allLessEqual(g_state.R.thread[i], f_copy)) {
-			
-					addVectors(&f_copy, &g_state.B.thread[i]);
-					done.resource[i] = true;
-				}
-			}
-
-			else {
-
-				for(int i = 0; i < 4; i++) {
-
-					if(done.resource[i] == false) {
+# if AVOIDANCE
 
-						answerInt = 0;
-						goto LABEL;
-					}
-				}
+	//then check that after granting it, there is still an order in which every thread can get what it still needs and finish
+	answer = banker_allocation_is_safe(g_banker, t, r, a) ? SAFE : UNSAFE;
 
-				answerInt = 1;
-			}
-		}	
-	}
-	
 #endif
-  LABEL:;
   char tmp[60];
   sprintf(tmp, "%s : %s\n", out, answer? "yes" : "no" );
   printc(tmp, t);
@@ -172,58 +163,16 @@ bool isSafe(unsigned t, unsigned r, unsigned a){
 
 bool isDeadlocked(unsigned t){
 
-  Vector f_copy = g_state.f;
   bool answer = UNDEFINED;
   char out[57];
   sprintf(out, "[%d] T%u: Deadlock detected?", gettid(), t+1);
 
 # if DETECTION
 
-	int answerInt = -1;		//"undefined"
-	//int sequenceHolder = 0;
-	Vector done = {{4}};
-
-	for(int i = 0; i < 4; i++) {
-
-			done.resource[i] = false;
-	}
-	
-
-	while(answerInt == -1) {
-
-
-		for(int i = 0; i < 4; i++) {
-
-			if(done.resource[i] == false) {
-
-				if(allLessEqual(g_state.R.thread[i], f_copy)) {
-			
-					addVectors(&f_copy, &g_state.B.thread[i]);
-					done.resource[i] = true;
-				}
-			}
-
-			else {
-
-				for(int i = 0; i < 4; i++) {
-
-					if(done.resource[i] == false) {
-
-						answerInt = 0;	//deadlock
-						goto LABEL;
-					}
-				}
-
-				answerInt = 1;
-			}
-		}	
-	}
-
-	if(answerInt) answer = SAFE;
-	else if(!answerInt) answer = UNSAFE;
+	//deadlocked if t waits on a cycle of blocked threads that nobody who can still finish will free enough to break
+	answer = waitfor_is_deadlocked(g_waitfor, g_banker, t) ? UNSAFE : SAFE;
 	
 #endif
-  LABEL:;
   
   char tmp[60];
   sprintf(tmp, "%s : %s\n", out, answer? "no" : "yes" );
@@ -236,6 +185,30 @@ bool isDeadlocked(unsigned t){
   return answer? false : true;
 }
 
+/** Same as grant, but never lets go of the state lock **/
+bool grant_locked(unsigned t, unsigned r, unsigned a){
+
+# if AVOIDANCE && OPTIMISTIC
+  return banker_mt_try_allocate(g_banker_mt, t, r, a);
+# else
+  if( isSafe(t, r, a) == UNSAFE )
+    return false;
+  banker_allocate(g_banker, t, r, a);
+  return true;
+# endif
+}
+
+/** Grant the allocation to the safety check's copy of the state if it is safe; called and returns with the state locked **/
+bool grant(unsigned t, unsigned r, unsigned a){
+
+# if AVOIDANCE && OPTIMISTIC
+  //the check runs on a snapshot, with the lock dropped
+  return banker_mt_allocate(g_banker_mt, t, r, a);
+# else
+  return grant_locked(t, r, a);
+# endif
+}
+
 void lock_state(unsigned t){
   printd("about to lock state");
   pthread_mutex_lock(&(g_state.mutex));
@@ -249,34 +222,7 @@ void unlock_state(unsigned t){
 
 
 //after an allocation, the process which has allocated should have those allocated resources in its "Belegt"/"Allocated" matrix, and the "free" matrix should be decremented by the same amount
-void allocate_r(unsigned t, unsigned r, unsigned a){
-
-  char tmp[50]; 
-  struct timespec ts;
-
-  lock_state(t);
-
-  clock_gettime(CLOCK_REALTIME, &ts);
-  ts.tv_sec += 2;
-  int alreadyWaited = 0;
-
-  /* wait if request wasn't granted */
-  while( (isSafe(t, r, a) == UNSAFE) ){
-    sprintf(tmp, "[%d] T%u: waiting to allocate(%c, %u)\n",
-        gettid(), t+1, LABEL[r], a);
-    printc(tmp, t);
-	
-	//fill current needs matrix
-	currentNeeds.thread[t].resource[r] = a;
-    
-    /* first wait is a timed wait */
-    if( !alreadyWaited )
-      alreadyWaited = pthread_cond_timedwait(&(g_state.resource_released[r]),
-        &(g_state.mutex), &ts);
-    else
-      pthread_cond_wait(&(g_state.resource_released[r]),
-        &(g_state.mutex));
-  }
+void hand_over(unsigned t, unsigned r, unsigned a){
 
 	//subtract 'a' amount of resource from the index to which resource r corresponds in the free resource vector
 	g_state.f.resource[r] = g_state.f.resource[r] - a;
@@ -291,16 +237,77 @@ void allocate_r(unsigned t, unsigned r, unsigned a){
 	//Vector f; /* frei - Available */
 
     printd("%u unit(s) of resource %c allocated", a, LABEL[r]);
-  
-  sprintf(tmp, "[%d] T%u: allocate(%c, %u)\n", gettid(), t+1,
-      LABEL[r], a);
-  printc(tmp, t);
+}
+
+/** The line's way of asking for a grant: a new request may drop the lock for its check, a waiter's never does **/
+int try_new_request(void *context, int t, int r, unsigned a){
+  return grant(t, r, a);
+}
+
+int try_waiter(void *context, int t, int r, unsigned a){
+  return grant_locked(t, r, a);
+}
+
+/** A waiter got its units: it is out of the line already, so take it out of the wait-for graph and wake it **/
+void waiter_granted(void *context, int t, int r, unsigned a){
+  hand_over(t, r, a);
+  waitfor_unblock(g_waitfor, t);
+  g_running++;
+  pthread_cond_signal(&(g_granted_signal[t]));
+}
+
+/** A thread lined up or finished; if that was the last one running, nobody else can serve the line **/
+void stop_running(){
+  g_running--;
+  if( g_running == 0 )
+    waitline_serve(g_line, try_waiter, waiter_granted, NULL);
+}
+
+void allocate_r(unsigned t, unsigned r, unsigned a){
+
+  char tmp[50]; 
+
+  lock_state(t);
+
+  /* only goes right away if nobody asked before us and is still waiting */
+  if( waitline_admit(g_line, t, r, a, try_new_request, NULL) ){
+    hand_over(t, r, a);
+  } else {
+    /* in line now; wait until a release grants the request */
+    sprintf(tmp, "[%d] T%u: waiting to allocate(%c, %u)\n",
+        gettid(), t+1, LABEL[r], a);
+    printc(tmp, t);
+	
+	//fill current needs matrix
+	currentNeeds.thread[t].resource[r] = a;
+
+    /* blocking adds the edges to the wait-for graph; a deadlock can only be closed by the thread that blocks last */
+    waitfor_block(g_waitfor, t, r, a);
+    # if DETECTION
+    if( isDeadlocked(t) ){
+      sprintf(tmp, "[%d] T%u: Deadlock detected!\n", gettid(), t+1);
+      printc(tmp, t);
+      print_State();
+      exit(EXIT_FAILURE);
+    }
+    # endif
+
+    /* whoever grants it also takes us out of the line and the wait-for graph, and hands the units over */
+    stop_running();
+    while( waitline_waiting(g_line, t) )
+      pthread_cond_wait(&(g_granted_signal[t]), &(g_state.mutex));
+  }
   
   #ifdef DEBUG
   print_State();
   #endif
 
   unlock_state(t);
+
+  /* log without holding up the others */
+  sprintf(tmp, "[%d] T%u: allocate(%c, %u)\n", gettid(), t+1,
+      LABEL[r], a);
+  printc(tmp, t);
 }
 
 void release_r(unsigned t, unsigned r, unsigned a){
@@ -317,20 +324,29 @@ void release_r(unsigned t, unsigned r, unsigned a){
 	//subtract 'a' amount of resource from index for resource 'r' within vector for thread 't' in 'B' matrix
 	g_state.B.thread[t].resource[r] = g_state.B.thread[t].resource[r] - a;	//(after a thread releases a resource, its "Belegt" vector is diminished by the amount of that resource it has released)
 
+	//and the same in the safety check's copy of the state
+# if AVOIDANCE && OPTIMISTIC
+	banker_mt_release(g_banker_mt, t, r, a);
+# else
+	banker_release(g_banker, t, r, a);
+# endif
+
 
   printd("%u unit(s) of resource %c released", a, LABEL[r]);
 
-  pthread_cond_signal(&(g_state.resource_released[r]));
+  /* any waiter may be able to go now, not just those waiting for r */
+  waitline_serve(g_line, try_waiter, waiter_granted, NULL);
 
-  sprintf(tmp, "[%d] T%u: release(%c, %u)\n", getpid(), t+1,
-      LABEL[r], a);
-  printc(tmp, t);
-  
   #ifdef DEBUG
   print_State();
   #endif
 
   unlock_state(t);
+
+  /* log without holding up the others */
+  sprintf(tmp, "[%d] T%u: release(%c, %u)\n", getpid(), t+1,
+      LABEL[r], a);
+  printc(tmp, t);
 }
 
 void *thread_work(void *thread_number){
@@ -384,30 +400,16 @@ void *thread_work(void *thread_number){
       usleep(10000);
       release_r(t, C, 3);
       break;
-    case NUM_THREADS:
-      /* DL-WatchDog */
-      /* poll resource state to check for deadlocks */
-      pthread_mutex_lock(&g_cfd_mutex);
-      while( g_checkForDeadlocks ){
-        pthread_mutex_unlock(&g_cfd_mutex);
-        usleep(1000000);
-        if( isDeadlocked(t) ){
-          char tmp[35];
-          sprintf(tmp, "[%d] T%ld: Deadlock detected!\n",
-              gettid(), t+1);
-          printc(tmp, t);
-          pthread_exit((void*)EXIT_FAILURE);
-        }
-        pthread_mutex_lock(&g_cfd_mutex);
-      }
-      pthread_mutex_unlock(&g_cfd_mutex);
-      break;
     default:
       printf("unexpected!");
       exit(EXIT_FAILURE);
       break;
   }
 
+  lock_state(t);
+  stop_running();
+  unlock_state(t);
+
   pthread_exit(EXIT_SUCCESS);
 }
 
@@ -438,8 +440,8 @@ int main(){
   pthread_attr_t attr;
   pthread_attr_init(&attr);
   pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
-  pthread_t thread[NUM_THREADS+1] = { 0 };
-  for(long t=FIRST_THREAD; t<=NUM_THREADS; t++){
+  pthread_t thread[NUM_THREADS] = { 0 };
+  for(long t=FIRST_THREAD; t<NUM_THREADS; t++){
     if( pthread_create(&thread[t], &attr, thread_work, (void *)t) ){
       handle_error("create");
     }
@@ -448,8 +450,7 @@ int main(){
 
   /* wait for threads */ 
   void *status;
-  unsigned finished = 0;
-  for(unsigned t=FIRST_THREAD; t<=NUM_THREADS; t++){
+  for(unsigned t=FIRST_THREAD; t<NUM_THREADS; t++){
     if( pthread_join(thread[t], &status) ){
       handle_error("join");
     }
@@ -459,24 +460,14 @@ int main(){
     } else {
       printf("\n[%d] T%u exited normally.\n", gettid(), t+1);
     }    
-    if( t<NUM_THREADS ) finished++;
-    /* tell DL-WatchDog to quit*/
-    if(finished==NUM_THREADS){
-      pthread_mutex_lock(&g_cfd_mutex);
-      g_checkForDeadlocks = false;
-      pthread_mutex_unlock(&g_cfd_mutex);
-    }  
   }
 
   /* Clean-up */
-  if( pthread_mutex_destroy(&g_cfd_mutex) ){
-    handle_error("mutex_destroy");
-  } 
   if( pthread_mutex_destroy(&(g_state.mutex)) ){
       handle_error("mutex_destroy");
   }
-  for(unsigned r=FIRST_RESOURCE; r<NUM_RESOURCES; r++){
-    if( pthread_cond_destroy(&(g_state.resource_released[r])) ){
+  for(unsigned t=FIRST_THREAD; t<NUM_THREADS; t++){
+    if( pthread_cond_destroy(&(g_granted_signal[t])) ){
         handle_error("cond_destroy");
     }
   }
@@ -485,6 +476,11 @@ int main(){
 
   print_State();
 
+  banker_mt_free(g_banker_mt);
+  banker_free(g_banker);
+  waitfor_free(g_waitfor);
+  waitline_free(g_line);
+
   exit(EXIT_SUCCESS);
 }
 
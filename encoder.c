@@ -0,0 +1,278 @@
+#include "encoder.h"
+#include <stdint.h>
+#include <string.h>
+
+#include "bitmap.h"
+
+				/** Picture Encoders **/
+/** .bmp: rows padded to 4 bytes, bottom row first. .ppm: rows top-down, red, green, blue, no padding. **/
+/** LZ container: the magic "RTLZ", width and height as 32-bit little-endian numbers, then one chunk per strip, top strip **/
+/** first: its raw size and compressed size (32-bit little-endian), then the strip's pixels as one LZ4 block. **/
+/** The LZ4 block format is the standard one, so any LZ4 block decoder can unpack a chunk; no library is needed to write it. **/
+
+#define BYTES_PER_PIXEL 3
+
+static void put32(unsigned char *out, uint32_t v)
+{
+	out[0] = v & 0xff;
+	out[1] = (v >> 8) & 0xff;
+	out[2] = (v >> 16) & 0xff;
+	out[3] = (v >> 24) & 0xff;
+}
+
+/*******BMP********/
+
+static size_t bmp_row_bytes(int width)
+{
+	return ((size_t)width * BYTES_PER_PIXEL + 3) & ~(size_t)3;
+}
+
+static int bmp_header(FILE *file, int width, int height)
+{
+	write_bitmap_header(file, width, height);
+	return ferror(file) ? -1 : 0;
+}
+
+static size_t bmp_bound(int width, int rows)
+{
+	return bmp_row_bytes(width) * rows;
+}
+
+static size_t bmp_strip(unsigned char *out, const unsigned char *pixels, int width, int rows)
+{
+	size_t row_bytes = bmp_row_bytes(width);
+	size_t pixel_bytes = (size_t)width * BYTES_PER_PIXEL;
+
+	//the strip's bottom row goes first
+	for(int r = 0; r < rows; r++) {
+		unsigned char *line = out + r * row_bytes;
+		memcpy(line, pixels + (size_t)(rows - 1 - r) * pixel_bytes, pixel_bytes);
+		memset(line + pixel_bytes, 0, row_bytes - pixel_bytes);
+	}
+
+	return row_bytes * rows;
+}
+
+/*******PPM********/
+
+static int ppm_header(FILE *file, int width, int height)
+{
+	return fprintf(file, "P6\n%d %d\n255\n", width, height) < 0 ? -1 : 0;
+}
+
+static size_t ppm_bound(int width, int rows)
+{
+	return (size_t)width * rows * BYTES_PER_PIXEL;
+}
+
+static size_t ppm_strip(unsigned char *out, const unsigned char *pixels, int width, int rows)
+{
+	size_t count = (size_t)width * rows;
+
+	//blue, green, red becomes red, green, blue
+	for(size_t i = 0; i < count; i++) {
+		out[3 * i] = pixels[3 * i + 2];
+		out[3 * i + 1] = pixels[3 * i + 1];
+		out[3 * i + 2] = pixels[3 * i];
+	}
+
+	return count * BYTES_PER_PIXEL;
+}
+
+/*******LZ4 BLOCKS********/
+//a block is a run of sequences: a token byte (literal count in the high nibble, match length - 4 in the low one, 15 meaning
+//"more length bytes follow"), the literals, a 16-bit back reference and the rest of the match length. the last sequence
+//is literals only. matches are found with a hash table of 4-byte prefixes, one candidate per slot.
+
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 5	//the format wants the last 5 bytes as literals,
+#define LZ_MATCH_LIMIT 12	//and no match starting in the last 12 bytes
+#define LZ_MAX_OFFSET 65535
+
+static uint32_t read32(const unsigned char *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static unsigned int hash4(uint32_t v)
+{
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/** A length of 15 or more spills into extra bytes: 255 each until the rest fits in one **/
+static unsigned char *put_length(unsigned char *op, size_t length)
+{
+	while(length >= 255) {
+		*op++ = 255;
+		length -= 255;
+	}
+	*op++ = (unsigned char)length;
+	return op;
+}
+
+static unsigned char *put_literals(unsigned char *op, const unsigned char *literals, size_t count, unsigned int match_nibble)
+{
+	*op++ = (unsigned char)((count >= 15 ? 15 : count) << 4 | match_nibble);
+	if(count >= 15)
+		op = put_length(op, count - 15);
+
+	memcpy(op, literals, count);
+	return op + count;
+}
+
+size_t lz_compress_bound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+size_t lz_compress(unsigned char *out, const unsigned char *in, size_t size)
+{
+	uint32_t table[1 << LZ_HASH_BITS] = { 0 };	//offset of the last position seen with each hash
+	const unsigned char *ip = in, *anchor = in, *end = in + size;
+	unsigned char *op = out;
+
+	if(size > LZ_MATCH_LIMIT) {
+
+		const unsigned char *last_start = end - LZ_MATCH_LIMIT;
+		const unsigned char *last_end = end - LZ_LAST_LITERALS;
+
+		while(ip <= last_start) {
+
+			uint32_t sequence = read32(ip);
+			unsigned int h = hash4(sequence);
+			const unsigned char *ref = in + table[h];
+			table[h] = (uint32_t)(ip - in);
+
+			if(ref >= ip || ip - ref > LZ_MAX_OFFSET || read32(ref) != sequence) {
+				ip++;
+				continue;
+			}
+
+			size_t length = LZ_MIN_MATCH;
+			while(ip + length < last_end && ref[length] == ip[length])
+				length++;
+
+			size_t match = length - LZ_MIN_MATCH;
+			size_t offset = ip - ref;
+
+			op = put_literals(op, anchor, ip - anchor, match >= 15 ? 15 : (unsigned int)match);
+			*op++ = offset & 0xff;
+			*op++ = offset >> 8;
+			if(match >= 15)
+				op = put_length(op, match - 15);
+
+			ip += length;
+			anchor = ip;
+		}
+	}
+
+	op = put_literals(op, anchor, end - anchor, 0);
+	return op - out;
+}
+
+long lz_decompress(unsigned char *out, size_t capacity, const unsigned char *in, size_t size)
+{
+	const unsigned char *ip = in, *end = in + size;
+	unsigned char *op = out, *out_end = out + capacity;
+
+	while(ip < end) {
+
+		unsigned int token = *ip++;
+		size_t count = token >> 4;
+		unsigned int more;
+
+		if(count == 15) {
+			do {
+				if(ip >= end)
+					return -1;
+				more = *ip++;
+				count += more;
+			} while(more == 255);
+		}
+
+		if(count > (size_t)(end - ip) || count > (size_t)(out_end - op))
+			return -1;
+		memcpy(op, ip, count);
+		op += count;
+		ip += count;
+
+		if(ip == end)
+			break;		//the last sequence has no match
+
+		if(end - ip < 2)
+			return -1;
+		size_t offset = ip[0] | ip[1] << 8;
+		ip += 2;
+		if(offset == 0 || offset > (size_t)(op - out))
+			return -1;
+
+		size_t length = token & 15;
+		if(length == 15) {
+			do {
+				if(ip >= end)
+					return -1;
+				more = *ip++;
+				length += more;
+			} while(more == 255);
+		}
+		length += LZ_MIN_MATCH;
+
+		if(length > (size_t)(out_end - op))
+			return -1;
+
+		//byte by byte: the match may overlap what it's copying
+		const unsigned char *ref = op - offset;
+		for(size_t i = 0; i < length; i++)
+			op[i] = ref[i];
+		op += length;
+	}
+
+	return op - out;
+}
+
+/*******LZ CONTAINER********/
+
+#define LZ_CHUNK_HEADER 8
+
+static int lz_header(FILE *file, int width, int height)
+{
+	unsigned char header[12] = { 'R', 'T', 'L', 'Z' };
+	put32(header + 4, width);
+	put32(header + 8, height);
+	return fwrite(header, sizeof(header), 1, file) == 1 ? 0 : -1;
+}
+
+static size_t lz_bound(int width, int rows)
+{
+	return LZ_CHUNK_HEADER + lz_compress_bound((size_t)width * rows * BYTES_PER_PIXEL);
+}
+
+static size_t lz_strip(unsigned char *out, const unsigned char *pixels, int width, int rows)
+{
+	size_t raw = (size_t)width * rows * BYTES_PER_PIXEL;
+	size_t packed = lz_compress(out + LZ_CHUNK_HEADER, pixels, raw);
+
+	put32(out, raw);
+	put32(out + 4, packed);
+	return LZ_CHUNK_HEADER + packed;
+}
+
+const encoder ENCODER_BMP = { "bmp", "bmp", 1, bmp_header, bmp_bound, bmp_strip };
+const encoder ENCODER_PPM = { "ppm", "ppm", 0, ppm_header, ppm_bound, ppm_strip };
+const encoder ENCODER_LZ = { "lz", "rtlz", 0, lz_header, lz_bound, lz_strip };
+
+const encoder *encoder_find(const char *name)
+{
+	const encoder *all[] = { &ENCODER_BMP, &ENCODER_PPM, &ENCODER_LZ };
+
+	for(size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+		if(strcmp(all[i]->name, name) == 0)
+			return all[i];
+	}
+
+	printf("Unknown encoder %s.\n", name);
+	return NULL;
+}
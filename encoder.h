@@ -0,0 +1,32 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/** Output formats for a rendered picture, encoded strip by strip **/
+/** Every strip is encoded on its own, so strips can be encoded in parallel and then written one after the other. **/
+/** Strips come in as the renderer makes them: rows top-down, 3 bytes per pixel in blue, green, red order as in a .bmp **/
+
+typedef struct
+{
+	const char *name;
+	const char *extension;
+	int bottom_up;		//the file starts with the bottom of the picture, so strips must be encoded and written bottom strip first
+	int (*header)(FILE *file, int width, int height);		//returns 0 on success
+	size_t (*bound)(int width, int rows);				//most bytes a strip of rows rows can encode to
+	size_t (*strip)(unsigned char *out, const unsigned char *pixels, int width, int rows);	//returns the bytes put in out
+} encoder;
+
+extern const encoder ENCODER_BMP;	//uncompressed 24-bit .bmp
+extern const encoder ENCODER_PPM;	//binary .ppm (P6)
+extern const encoder ENCODER_LZ;	//chunked container of LZ4-compressed strips, see encoder.c
+
+const encoder *encoder_find(const char *name);
+
+/** LZ4 block format codec, as used by ENCODER_LZ; decompress returns the decoded size, or -1 if the input is damaged **/
+size_t lz_compress_bound(size_t size);
+size_t lz_compress(unsigned char *out, const unsigned char *in, size_t size);
+long lz_decompress(unsigned char *out, size_t capacity, const unsigned char *in, size_t size);
+
+#endif
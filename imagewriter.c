@@ -1,241 +1,1449 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <errno.h>
-#include <limits.h>
-#include <unistd.h>
-#include <sys/types.h>
-#include <sys/wait.h>
-
-#include "bitmap.h"
-#include "color.h"
-#include "raytrace.h"
-#include "util.h"
-
-																			/** Raytracer: Image Writer **/
-/** Given image data and a file destination, writes the image pixel-by-pixel as a .bmp to the file destination.  **/
-/** Displays comparative speeds of writing through simple, loop, and parallel processes.  **/
-/** Samantha Tite-Webber, 2015.  **/
-
-
-void init_raytracer () {
-	// init raytracer
-	vec_t bounds[4];
-	scene_t *scene = create_scene();
-	calculate_casting_bounds(scene->cam, bounds);
-}
-
-
-/*******SIMPLE WRITE: write image from top to bottom**********/
-int raytracer_simple(const char* filename){
-
-	printf("%s      :  ", filename);
-	unsigned long start, end;
-
-	// init time measurement
-	start = current_time_millis();
-
-	// init raytracer
-	init_raytracer();
-
-	// Allocate buffer for picture data
-	pix_t *img = (pix_t*) calloc(HEIGHT * WIDTH, sizeof(pix_t));
-	if (img){
-
-		// calculate the data for the image (do the actual raytrace)
-		raytrace(img, bounds, scene, 0, 0, WIDTH, HEIGHT);
-
-		delete_scene(scene);
-
-		// open file
-		FILE *file = fopen(filename, "wb");
-		if (file) {
-			// write the header
-			write_bitmap_header(file, WIDTH, HEIGHT);
-
-			// write image to file on disk
-			fwrite(img, 3, WIDTH * HEIGHT, file);
-
-			// free buffer
-			free(img);
-			
-			// close file
-			fclose(file);
-			
-			// print the measured time
-			end = current_time_millis();
-			printf("Render time: %.3fs\n", (double) (end - start) / 1000);
-			
-			return EXIT_SUCCESS;
-		}
-	}
-	return EXIT_FAILURE;
-}
-
-/***********LOOP WRITE: Split image into segments and iterate through segments in a loop**********/
-int raytracer_loop(const char* filename, int processcount){
-
-	printf("%s (%i)    :  ", filename, processcount);
-	unsigned long start, end;
-	int success = EXIT_FAILURE;
-
-	// init time measurement
-	start = current_time_millis();
-
-	// init raytracer
-	init_raytracer();
-
-	//split image calculation into segments - keep one set of offsets constant, as in, we always draw from top to bottom,
-	//and the other set of offsets changes depending on the step in the for-loop. we can write to the image within this same loop,
-	//keeping in mind that the header will only be written once.
-
-	//allocate buffer for picture data. we want enough space for the entire picture, so we give the whole lengths of width and height
-	pix_t *img = (pix_t*) calloc(HEIGHT * WIDTH, sizeof(pix_t));
-
-	//open file for writing picture data
-	FILE *file = fopen(filename, "wb");
-
-	// write the header
-	write_bitmap_header(file, WIDTH, HEIGHT);
-
-	//we write in sections across the photo, always from left to right with height of HEIGHT/process count. Thus we pass a constant height,
-	//while the y offset is always the endpoint of the last trace, starting with 0 during the first trace.
-	for(int i = 0; i < processcount; i++) {
-
-		int y = HEIGHT/processcount;
-
-		if(i == processcount - 1) {
-			
-			y+= HEIGHT%processcount;
-		}
-	
-		raytrace(img, bounds, scene, 0, i*y, WIDTH, (HEIGHT/processcount));
-
-		if(img && file) {
-		
-			success = EXIT_SUCCESS;
-			fwrite(img, 3, WIDTH * y, file);	//always write the same amount of space; "img" will determine
-										//what section of the photo we are writing in that space
-		}
-	}
-
-	delete_scene(scene);
-
-	// free buffer
-	free(img);
-			
-	// close file
-	fclose(file);
-
-	// print the measured time
-	end = current_time_millis();
-	printf("Render time: %.3fs\n", (double) (end - start) / 1000);
-	
-	return success;
-}
-
-/*******PARALLEL WRITE: Split image into segments, and spawn one process for the writing of each portion********/
-int raytracer_parallel(const char* filename, int processcount) {
-
-	printf("%s (%i):  ", filename, processcount);
-	unsigned long start, end;
-
-	int status = 0;
-
-	// init time measurement
-	start = current_time_millis();
-
-	// init raytracer
-	init_raytracer();
-
-	FILE *file = fopen(filename, "wb");
-
-	if(file) {
-	
-		// write the header
-		write_bitmap_header(file, WIDTH, HEIGHT);
-
-		unsigned char pixels [3] = {255, 255, 0};
-
-		for(int i = 0; i < processcount; i++) {
-			fwrite(pixels, sizeof(pix_t), WIDTH * HEIGHT, file);
-		}
-	}
-
-	fclose(file);
-
-	//spawn one process for each portion of the photo, and handle file management in this process
-	for(int i = 0; i < processcount; i++) {
-
-		pid_t childPID = fork();
-
-		//check for error in spawning
-		if(childPID < 0) {
-			perror("Error spawning new process. Exiting.\n");
-			exit(-1);
-		}
-
-		//when inside a child process
-		if(childPID == 0) {
-
-			//allocate space in memory for this process' portion of the photo
-			pix_t *img = (pix_t*) calloc((HEIGHT/processcount) * WIDTH, sizeof(pix_t));
-
-			//open file for writing picture data
-			FILE *file = fopen(filename, "rb+");
-
-			if(file && img) {
-
-				//write image data to portion in memory
-				raytrace(img, bounds, scene, 0, i*(HEIGHT/processcount), WIDTH, (HEIGHT/processcount));
-
-				//write data in memory to file
-		//		fseek(file, BITMAP_HEADER_SIZE+((HEIGHT/processcount)*i), SEEK_SET);	//first determine place to write in file
-	//			fwrite(img, 3, WIDTH * (HEIGHT/processcount), file);	//then write from this point to the point reached by offset
-
-				//clean up...
-				free(img);	// free buffer
-				fclose(file);
-			}
-
-			else {
-				printf("Error opening file or allocating memory in portion %d.\n", i);
-			}
-			
-			exit(0);	//finished with duties for this process; leave
-		}
-	}
-
-	//wait for all children to finish, then continue with the parent process
-	while(wait(&status) > 0);
-
-	delete_scene(scene);
-	end = current_time_millis();
-	printf("Render time: %.3fs\n", (double) (end - start) / 1000);
-	
-	return EXIT_SUCCESS;
-}
-
-int main(int argc, char** argv) {
-
-	if (argc != 2) {
-		printf("Usage: raytracer PROCESSCOUNT\n");
-		return EXIT_FAILURE;
-	}
-	
-	unsigned int processcount = strtol(argv[1], NULL, 10);
-
-	if (raytracer_simple("image-simple.bmp") != EXIT_SUCCESS){
-		printf("Error or not implemented.\n\n");
-	}
-	
-	if (raytracer_loop("image-loop.bmp", processcount) != EXIT_SUCCESS){
-		printf("Error or not implemented.\n\n");
-	}
-
-	if (raytracer_parallel("image-parallel.bmp", processcount) != EXIT_SUCCESS){
-		printf("Error or not implemented.\n\n");
-	}
-
-
-	return 0;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#include "bitmap.h"
+#include "color.h"
+#include "raytrace.h"
+#include "util.h"
+#include "partition.h"
+#include "encoder.h"
+
+																			/** Raytracer: Image Writer **/
+/** Given image data and a file destination, writes the image pixel-by-pixel as a .bmp to the file destination.  **/
+/** Displays comparative speeds of writing through simple, loop, parallel (thread pool), memory-mapped, streaming, progressive and encoded rendering.  **/
+/** Samantha Tite-Webber, 2015.  **/
+
+
+/*******SCENE: everything a render reads but never changes********/
+//built once in main, before any render, and shared read-only by every mode and every worker thread, so that
+//building it is not part of any render's time. freed once, after the last render.
+typedef struct
+{
+	scene_t *scene;
+	vec_t bounds[4];	//the casting bounds of the scene's camera
+} render_scene;
+
+render_scene *render_scene_new(void) {
+
+	render_scene *rs = (render_scene*) malloc(sizeof(render_scene));
+	if (!rs)
+		return NULL;
+
+	rs->scene = create_scene();
+	if (!rs->scene) {
+		free(rs);
+		return NULL;
+	}
+
+	calculate_casting_bounds(rs->scene->cam, rs->bounds);
+	return rs;
+}
+
+void render_scene_free(render_scene *rs) {
+
+	if (!rs)
+		return;
+
+	delete_scene(rs->scene);
+	free(rs);
+}
+
+
+/*******BMP LAYOUT********/
+//in a .bmp file every row is padded to a multiple of 4 bytes, and the rows are stored bottom-up: the file starts with the
+//bottom row of the picture. raytrace hands out rows top-down, so every mode traces each row straight to the place it
+//has in the file, addressing rows from the bottom with a negative row step. that way all modes write the same bytes.
+#define BMP_ROW_BYTES ((long) ((WIDTH * sizeof(pix_t) + 3) & ~(size_t) 3))
+
+//one render's worth of work: the scene, the regions of the picture to trace, and where the pixels go.
+//picture row y starts at base + (y - first_row) * row_bytes
+typedef struct
+{
+	const render_scene *scene;
+	const region *regions;		//work item i is regions[i]
+	unsigned char *base;
+	long row_bytes;
+	int first_row;
+	double *cost;			//if not NULL, how long each region took, in ns, for splitting the next render by cost
+} render_job;
+
+/** Point a job at a buffer holding picture rows y0 ... y1-1 the way they sit in a .bmp: bottom-up and padded **/
+static void bmp_target(render_job *job, unsigned char *rows, int y0, int y1) {
+
+	job->base = rows + (long) (y1 - 1 - y0) * BMP_ROW_BYTES;
+	job->row_bytes = -BMP_ROW_BYTES;
+	job->first_row = y0;
+}
+
+static double now_ns(void) {
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/** Work item: raytrace one region of the picture into its place **/
+//whole rows are traced straight into the picture. narrower regions (tiles) go through the scratch space first, since
+//raytrace writes w*h packed pixels, and are then copied out row by row; scratch must hold TILE_SIZE x TILE_SIZE pixels.
+static void render_region(void *ctx, int item, pix_t *scratch) {
+
+	render_job *job = (render_job*) ctx;
+	region r = job->regions[item];
+	vec_t *bounds = (vec_t*) job->scene->bounds;		//raytrace takes plain pointers, but only reads through them
+	double start = job->cost ? now_ns() : 0;
+
+	if(r.w == WIDTH) {
+		for(int y = r.y; y < r.y + r.h; y++)
+			raytrace((pix_t*) (job->base + (long) (y - job->first_row) * job->row_bytes), bounds, job->scene->scene, 0, y, WIDTH, 1);
+	}
+
+	else {
+		raytrace(scratch, bounds, job->scene->scene, r.x, r.y, r.w, r.h);
+
+		for(int row = 0; row < r.h; row++) {
+			memcpy(job->base + (long) (r.y + row - job->first_row) * job->row_bytes + (long) r.x * sizeof(pix_t),
+				scratch + row * r.w, r.w * sizeof(pix_t));
+		}
+	}
+
+	if(job->cost)
+		job->cost[item] = now_ns() - start;
+}
+
+//how long each row took the last time the whole picture was rendered, so the next strip split can balance cost
+static double g_row_cost[HEIGHT];
+static int g_have_row_cost = 0;
+
+static void remember_cost(const partition *part, const double *cost) {
+
+	partition_row_cost(part, cost, g_row_cost, HEIGHT);
+	g_have_row_cost = 1;
+}
+
+//where a render spends its time, in ns. trace is raytracing, encode is laying out the file around the pixels (the
+//header; the pixels themselves are traced in file layout), write is handing the bytes to the file and closing it
+typedef struct
+{
+	double setup;		//partition, buffers, opening the file
+	double trace;
+	double encode;
+	double write;
+	long rays;		//primary rays traced, for the modes that don't trace one per pixel; 0 for the ones that do
+} render_times;
+
+static int g_quiet = 0;		//set while benchmarking: the modes keep their timings to themselves
+
+/** End the current phase: add the time since *mark to *phase, and start the next phase now **/
+static void lap(double *phase, double *mark) {
+
+	double now = now_ns();
+	*phase += now - *mark;
+	*mark = now;
+}
+
+static double render_total(const render_times *times) {
+
+	return times->setup + times->trace + times->encode + times->write;
+}
+
+static void print_render_time(const render_times *times) {
+
+	if (!g_quiet)
+		printf("Render time: %.3fs\n", render_total(times) / 1e9);
+}
+
+
+/*******SIMPLE WRITE: write image from top to bottom**********/
+int raytracer_simple(const char* filename, const render_scene *scene, render_times *times){
+
+	if (!g_quiet)
+		printf("%s      :  ", filename);
+	int success = EXIT_FAILURE;
+
+	// init time measurement
+	*times = (render_times) { 0 };
+	double mark = now_ns();
+
+	// one row per region, traced in order; timing every row gives the cost map the other modes split by
+	partition rows;
+	partition_make(&rows, PARTITION_ROWS, WIDTH, HEIGHT, HEIGHT, 0, NULL);
+
+	// Allocate buffer for picture data, padding included
+	unsigned char *img = (unsigned char*) calloc(HEIGHT, BMP_ROW_BYTES);
+	double *cost = (double*) malloc(HEIGHT * sizeof(double));
+	FILE *file = fopen(filename, "wb");
+
+	if (img && cost && rows.regions && file) {
+
+		lap(&times->setup, &mark);
+
+		// calculate the data for the image (do the actual raytrace)
+		render_job job = { scene, rows.regions, NULL, 0, 0, cost };
+		bmp_target(&job, img, 0, HEIGHT);
+
+		for (int i = 0; i < rows.count; i++)
+			render_region(&job, i, NULL);
+
+		remember_cost(&rows, cost);
+		lap(&times->trace, &mark);
+
+		// write the header, then the image to file on disk
+		write_bitmap_header(file, WIDTH, HEIGHT);
+		lap(&times->encode, &mark);
+
+		fwrite(img, 1, HEIGHT * BMP_ROW_BYTES, file);
+		fclose(file);
+		file = NULL;
+		lap(&times->write, &mark);
+
+		success = EXIT_SUCCESS;
+	}
+
+	else {
+		printf("Error opening file or allocating memory.\n");
+	}
+
+	// free buffers, close file
+	free(img);
+	free(cost);
+	partition_free(&rows);
+	if (file)
+		fclose(file);
+
+	// print the measured time
+	print_render_time(times);
+
+	return success;
+}
+
+/***********LOOP WRITE: Split image into segments and iterate through segments in a loop**********/
+int raytracer_loop(const char* filename, const render_scene *scene, int processcount, render_times *times){
+
+	if (!g_quiet)
+		printf("%s (%i)    :  ", filename, processcount);
+	int success = EXIT_FAILURE;
+
+	// init time measurement
+	*times = (render_times) { 0 };
+	double mark = now_ns();
+
+	//split image calculation into processcount strips of whole rows. once a render has been timed, the strips are split
+	//by cost instead of by height, so a strip full of slow rows is shorter. each strip is traced into one strip buffer
+	//and written before the next one; the header is only written once.
+	partition strips;
+	partition_make(&strips, PARTITION_ROWS, WIDTH, HEIGHT, processcount, 0, g_have_row_cost ? g_row_cost : NULL);
+
+	int tallest = 0;
+	for (int i = 0; i < strips.count; i++) {
+		if (strips.regions[i].h > tallest)
+			tallest = strips.regions[i].h;
+	}
+
+	//allocate buffer for one strip of picture data: enough space for the tallest strip, padding included
+	unsigned char *strip = (unsigned char*) calloc(tallest ? tallest : 1, BMP_ROW_BYTES);
+	double *cost = (double*) malloc((strips.count ? strips.count : 1) * sizeof(double));
+
+	//open file for writing picture data
+	FILE *file = fopen(filename, "wb");
+
+	if (strip && cost && strips.regions && file) {
+
+		lap(&times->setup, &mark);
+
+		// write the header
+		write_bitmap_header(file, WIDTH, HEIGHT);
+		lap(&times->encode, &mark);
+
+		//a .bmp starts with the bottom row, so the strips are written from the bottom strip up. each strip's rows go into
+		//the buffer bottom-up as well, so that the buffer can be written out as it is.
+		render_job job = { scene, strips.regions, NULL, 0, 0, cost };
+
+		for (int i = strips.count - 1; i >= 0; i--) {
+
+			region r = strips.regions[i];
+			bmp_target(&job, strip, r.y, r.y + r.h);
+			render_region(&job, i, NULL);
+			lap(&times->trace, &mark);
+
+			fwrite(strip, 1, r.h * BMP_ROW_BYTES, file);
+			lap(&times->write, &mark);
+		}
+
+		fclose(file);
+		file = NULL;
+		lap(&times->write, &mark);
+
+		remember_cost(&strips, cost);
+		success = EXIT_SUCCESS;
+	}
+
+	else {
+		printf("Error opening file or allocating memory.\n");
+	}
+
+
+	// free buffers
+	free(strip);
+	free(cost);
+	partition_free(&strips);
+
+	// close file
+	if (file)
+		fclose(file);
+
+	// print the measured time
+	print_render_time(times);
+	
+	return success;
+}
+
+/*******RENDER POOL: persistent worker threads, started once and reused by every render********/
+//a render hands the pool a batch of numbered work items (e.g. tiles) and a function that does one item. workers grab
+//the next unclaimed item off a shared counter until none are left, so a thread that drew cheap items simply takes more of
+//them, and an expensive corner of the image can't hold up a whole strip's worth of work on one thread.
+
+#define TILE_SIZE 32		//tiles are TILE_SIZE x TILE_SIZE pixels, smaller at the right and bottom edges
+
+typedef void (*work_fn)(void *ctx, int item, pix_t *scratch);
+
+typedef struct
+{
+	pthread_t *thread;
+	int threads;
+	pthread_mutex_t lock;
+	pthread_cond_t start;		//signalled when a new batch is ready, or when it's time to quit
+	pthread_cond_t done;		//signalled when the last worker finishes its part of a batch
+	work_fn work;			//the current batch: what to do,
+	void *ctx;			//with which data,
+	int items;			//for how many items
+	atomic_int next;		//next item nobody has claimed yet
+	int running;			//workers still busy with the current batch
+	unsigned int batch;		//counts batches, so a worker can tell a new batch from a spurious wakeup
+	int quit;
+	int ready;			//workers that have started, and
+	int failed;			//whether any of them couldn't get its scratch tile
+} render_pool;
+
+static void *pool_worker(void *arg) {
+
+	render_pool *pool = (render_pool*) arg;
+	pix_t *scratch = (pix_t*) malloc(TILE_SIZE * TILE_SIZE * sizeof(pix_t));	//each worker renders a tile here before copying it out
+	unsigned int seen = 0;
+
+	// report in, so render_pool_new knows whether every worker is able to take work
+	pthread_mutex_lock(&pool->lock);
+	pool->ready++;
+	if(!scratch)
+		pool->failed = 1;
+	pthread_cond_signal(&pool->done);
+
+	while(1) {
+
+		while(!pool->quit && pool->batch == seen)
+			pthread_cond_wait(&pool->start, &pool->lock);
+
+		if(pool->quit)
+			break;
+
+		seen = pool->batch;
+		pthread_mutex_unlock(&pool->lock);
+
+		int item;
+		while((item = atomic_fetch_add(&pool->next, 1)) < pool->items)
+			pool->work(pool->ctx, item, scratch);
+
+		pthread_mutex_lock(&pool->lock);
+		if(--pool->running == 0)
+			pthread_cond_signal(&pool->done);
+	}
+
+	pthread_mutex_unlock(&pool->lock);
+	free(scratch);
+	return NULL;
+}
+
+void render_pool_free(render_pool *pool) {
+
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	for(int i = 0; i < pool->threads; i++)
+		pthread_join(pool->thread[i], NULL);
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->thread);
+	free(pool);
+}
+
+render_pool *render_pool_new(int threads) {
+
+	render_pool *pool = (render_pool*) calloc(1, sizeof(render_pool));
+	if(!pool)
+		return NULL;
+
+	pool->thread = (pthread_t*) calloc(threads, sizeof(pthread_t));
+	if(!pool->thread) {
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	for(int i = 0; i < threads; i++) {
+		if(pthread_create(&pool->thread[i], NULL, pool_worker, pool) != 0) {
+			perror("Error spawning render thread");
+			break;
+		}
+		pool->threads++;
+	}
+
+	// wait for the workers to report in; a pool short of a thread, or with one that can't work, is no use
+	pthread_mutex_lock(&pool->lock);
+	while(pool->ready < pool->threads)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	int failed = pool->failed;
+	pthread_mutex_unlock(&pool->lock);
+
+	if(pool->threads != threads || failed) {
+		if(failed)
+			printf("Could not allocate scratch space for a render thread.\n");
+		else
+			printf("Could only start %d of %d render threads.\n", pool->threads, threads);
+		render_pool_free(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+/** Run items work items on the pool and return once all of them are done **/
+void render_pool_run(render_pool *pool, int items, work_fn work, void *ctx) {
+
+	pthread_mutex_lock(&pool->lock);
+
+	pool->work = work;
+	pool->ctx = ctx;
+	pool->items = items;
+	atomic_store(&pool->next, 0);
+	pool->running = pool->threads;
+	pool->batch++;
+	pthread_cond_broadcast(&pool->start);
+
+	while(pool->running > 0)
+		pthread_cond_wait(&pool->done, &pool->lock);
+
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*******PARALLEL WRITE: Split the image up with the partitioner, and let the render pool's threads trace all of it into one shared picture********/
+//the regions don't overlap, so the threads never write the same bytes. strips are split by cost once a render has been
+//timed, tiles are the pool's natural unit of work, Z-ordered tiles keep neighbouring work together, and interleaved
+//scanlines spread every part of the picture over all threads.
+int raytracer_parallel(const char* filename, const render_scene *scene, render_pool *pool, partition_kind kind, render_times *times) {
+
+	if(!g_quiet)
+		printf("%s (%i):  ", filename, pool->threads);
+	int success = EXIT_FAILURE;
+
+	// init time measurement
+	*times = (render_times) { 0 };
+	double mark = now_ns();
+
+	// a few strips per thread, so a thread that finishes early still finds work
+	partition part;
+	int parts = (kind == PARTITION_ROWS) ? 4 * pool->threads : pool->threads;
+	partition_make(&part, kind, WIDTH, HEIGHT, parts, TILE_SIZE, g_have_row_cost ? g_row_cost : NULL);
+
+	// one picture for everyone, laid out as in the file
+	unsigned char *img = (unsigned char*) calloc(HEIGHT, BMP_ROW_BYTES);
+	double *cost = (double*) malloc((part.count ? part.count : 1) * sizeof(double));
+	FILE *file = fopen(filename, "wb");
+
+	if(img && cost && part.regions && file) {
+
+		lap(&times->setup, &mark);
+
+		render_job job = { scene, part.regions, NULL, 0, 0, cost };
+		bmp_target(&job, img, 0, HEIGHT);
+		render_pool_run(pool, part.count, render_region, &job);
+
+		remember_cost(&part, cost);
+		lap(&times->trace, &mark);
+
+		// write the header, then the whole picture at once
+		write_bitmap_header(file, WIDTH, HEIGHT);
+		lap(&times->encode, &mark);
+
+		fwrite(img, 1, HEIGHT * BMP_ROW_BYTES, file);
+		fclose(file);
+		file = NULL;
+		lap(&times->write, &mark);
+
+		success = EXIT_SUCCESS;
+	}
+
+	else {
+		printf("Error opening file or allocating memory.\n");
+	}
+
+	// clean up...
+	free(img);
+	free(cost);
+	partition_free(&part);
+	if(file)
+		fclose(file);
+
+	print_render_time(times);
+	
+	return success;
+}
+
+/*******MAPPED WRITE: size the file once, map it into memory, and let the render pool trace straight into the mapping********/
+//no picture buffer and no fwrite: the pixels land in the page cache where the file's data lives, and the kernel writes
+//them back on its own time. each worker's rows are its own slice of the mapping.
+int raytracer_mmap(const char* filename, const render_scene *scene, render_pool *pool, render_times *times) {
+
+	if(!g_quiet)
+		printf("%s (%i)    :  ", filename, pool->threads);
+	int success = EXIT_FAILURE;
+
+	// init time measurement
+	*times = (render_times) { 0 };
+	double mark = now_ns();
+
+	// one row per work item
+	partition rows;
+	partition_make(&rows, PARTITION_ROWS, WIDTH, HEIGHT, HEIGHT, 0, NULL);
+
+	FILE *file = fopen(filename, "wb+");
+
+	if(file && rows.regions) {
+
+		lap(&times->setup, &mark);
+
+		// write the header the usual way; wherever it ends is where the pixels start
+		write_bitmap_header(file, WIDTH, HEIGHT);
+		fflush(file);
+		long header_size = ftell(file);
+		lap(&times->encode, &mark);
+
+		size_t file_size = header_size + (size_t) HEIGHT * BMP_ROW_BYTES;
+		int fd = fileno(file);
+
+		// grow the file to its final size in one go, then map all of it
+		unsigned char *map = MAP_FAILED;
+		if(header_size >= 0 && ftruncate(fd, file_size) == 0)
+			map = (unsigned char*) mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+		if(map != MAP_FAILED) {
+
+			lap(&times->setup, &mark);
+
+			// the rows go where they are in the file; padding stays zero from ftruncate
+			render_job job = { scene, rows.regions, NULL, 0, 0, NULL };
+			bmp_target(&job, map + header_size, 0, HEIGHT);
+			render_pool_run(pool, rows.count, render_region, &job);
+			lap(&times->trace, &mark);
+
+			munmap(map, file_size);
+			success = EXIT_SUCCESS;
+		}
+
+		else {
+			perror("Error mapping output file");
+		}
+
+		fclose(file);
+		lap(&times->write, &mark);
+	}
+
+	else {
+		printf("Error opening file or allocating memory.\n");
+		if(file)
+			fclose(file);
+	}
+
+	partition_free(&rows);
+
+	print_render_time(times);
+
+	return success;
+}
+
+/*******STREAMED WRITE: render strip k+1 while strip k is being written, through a small fixed ring of strip buffers********/
+//peak memory is STREAM_RING strips no matter how big the picture is. the render pool fills a strip, a writer thread
+//pwrite()s it to its final offset in the file, and the strip buffer goes back into the ring for a later strip.
+
+#define STRIP_ROWS 16		//rows per strip
+#define STREAM_RING 4		//strip buffers in flight: one being rendered, the rest queued for or being written
+
+typedef struct
+{
+	pthread_mutex_t lock;
+	pthread_cond_t changed;		//signalled whenever rendered or written moves
+	unsigned char *strip[STREAM_RING];
+	int strips;			//strips in the whole picture
+	int rendered;			//strips handed to the writer so far
+	int written;			//strips the writer is done with so far
+	int fd;
+	long header_size;
+	int failed;			//set by the writer if a pwrite goes wrong
+} stream_state;
+
+/** Write len bytes at offset, carrying on after short writes **/
+static int pwrite_all(int fd, const unsigned char *buf, size_t len, off_t offset) {
+
+	while(len > 0) {
+		ssize_t n = pwrite(fd, buf, len, offset);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+		offset += n;
+	}
+	return 0;
+}
+
+static void *stream_writer(void *arg) {
+
+	stream_state *st = (stream_state*) arg;
+
+	for(int k = 0; k < st->strips; k++) {
+
+		pthread_mutex_lock(&st->lock);
+		while(st->rendered <= k)
+			pthread_cond_wait(&st->changed, &st->lock);
+		pthread_mutex_unlock(&st->lock);
+
+		// strip k holds picture rows y0 ... y1-1, already bottom-up and padded, so it is one contiguous run of the file
+		int y0 = k * STRIP_ROWS;
+		int y1 = (y0 + STRIP_ROWS < HEIGHT) ? y0 + STRIP_ROWS : HEIGHT;
+		off_t offset = st->header_size + (off_t) (HEIGHT - y1) * BMP_ROW_BYTES;
+
+		int error = pwrite_all(st->fd, st->strip[k % STREAM_RING], (size_t) (y1 - y0) * BMP_ROW_BYTES, offset);
+
+		pthread_mutex_lock(&st->lock);
+		if(error)
+			st->failed = 1;
+		st->written++;
+		pthread_cond_signal(&st->changed);
+		pthread_mutex_unlock(&st->lock);
+	}
+
+	return NULL;
+}
+
+int raytracer_stream(const char* filename, const render_scene *scene, render_pool *pool, render_times *times) {
+
+	if(!g_quiet)
+		printf("%s (%i)  :  ", filename, pool->threads);
+	int success = EXIT_FAILURE;
+
+	// init time measurement. tracing and writing overlap here: trace is the time spent rendering strips, write is the
+	// time the renderer spent waiting for the writer, plus finishing the last strips
+	*times = (render_times) { 0 };
+	double mark = now_ns();
+
+	// one row per work item; strip k's items are the rows from k * STRIP_ROWS on
+	partition rows;
+	partition_make(&rows, PARTITION_ROWS, WIDTH, HEIGHT, HEIGHT, 0, NULL);
+
+	stream_state st = { .strips = (HEIGHT + STRIP_ROWS - 1) / STRIP_ROWS };
+	int have_buffers = rows.regions != NULL;
+
+	for(int i = 0; i < STREAM_RING; i++) {
+		st.strip[i] = (unsigned char*) calloc(STRIP_ROWS, BMP_ROW_BYTES);	//calloc: the row padding stays zero
+		have_buffers = have_buffers && st.strip[i];
+	}
+
+	FILE *file = fopen(filename, "wb");
+
+	if(file && have_buffers) {
+
+		lap(&times->setup, &mark);
+
+		write_bitmap_header(file, WIDTH, HEIGHT);
+		fflush(file);
+		st.header_size = ftell(file);
+		st.fd = fileno(file);
+		lap(&times->encode, &mark);
+
+		pthread_mutex_init(&st.lock, NULL);
+		pthread_cond_init(&st.changed, NULL);
+
+		pthread_t writer;
+		if(pthread_create(&writer, NULL, stream_writer, &st) == 0) {
+
+			for(int k = 0; k < st.strips; k++) {
+
+				// wait for the writer to hand back the buffer strip k goes into
+				pthread_mutex_lock(&st.lock);
+				while(k - st.written >= STREAM_RING)
+					pthread_cond_wait(&st.changed, &st.lock);
+				pthread_mutex_unlock(&st.lock);
+				lap(&times->write, &mark);
+
+				int y0 = k * STRIP_ROWS;
+				int y1 = (y0 + STRIP_ROWS < HEIGHT) ? y0 + STRIP_ROWS : HEIGHT;
+				unsigned char *strip = st.strip[k % STREAM_RING];
+
+				// trace the strip's rows bottom-up into the buffer, the way they will sit in the file
+				render_job job = { scene, rows.regions + y0, NULL, 0, 0, NULL };
+				bmp_target(&job, strip, y0, y1);
+				render_pool_run(pool, y1 - y0, render_region, &job);
+				lap(&times->trace, &mark);
+
+				pthread_mutex_lock(&st.lock);
+				st.rendered++;
+				pthread_cond_signal(&st.changed);
+				pthread_mutex_unlock(&st.lock);
+			}
+
+			pthread_join(writer, NULL);
+			success = st.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+		}
+
+		pthread_cond_destroy(&st.changed);
+		pthread_mutex_destroy(&st.lock);
+
+		fclose(file);
+		file = NULL;
+		lap(&times->write, &mark);
+	}
+
+	else {
+		printf("Error opening file or allocating memory.\n");
+	}
+
+	if(file)
+		fclose(file);
+	for(int i = 0; i < STREAM_RING; i++)
+		free(st.strip[i]);
+	partition_free(&rows);
+
+	print_render_time(times);
+
+	return success;
+}
+
+/*******ENCODED WRITE: trace, encode and write strips at the same time, in any of the encoder's formats********/
+//the pool traces strip k while one of its threads encodes strip k-1 (the encoding is just one more work item in the
+//batch), and a writer thread appends strip k-2 to the file. the strips go in the encoder's file order, so formats that
+//start with the bottom of the picture trace the bottom strip first. memory stays at STREAM_RING strips, as for streaming.
+
+typedef struct
+{
+	pthread_mutex_t lock;
+	pthread_cond_t changed;		//signalled whenever encoded or written moves
+	unsigned char *raw[STREAM_RING];	//traced strips, packed rows top-down
+	unsigned char *out[STREAM_RING];	//the same strips encoded
+	size_t size[STREAM_RING];		//how many bytes of out each one is
+	int strips;
+	int encoded;			//strips handed to the writer so far
+	int written;			//strips the writer is done with so far
+	int fd;
+	off_t offset;			//where the next strip goes
+	int failed;
+} encode_state;
+
+//one batch for the pool: the rows of the strip to trace, plus (as item 0, so it starts first) encoding the strip before
+typedef struct
+{
+	render_job trace;
+	const encoder *enc;
+	const unsigned char *pixels;	//strip to encode, NULL if there's none this time
+	int rows;			//its height
+	unsigned char *out;
+	size_t size;
+} encode_batch;
+
+static void trace_or_encode(void *ctx, int item, pix_t *scratch) {
+
+	encode_batch *batch = (encode_batch*) ctx;
+
+	if(batch->pixels && item-- == 0)
+		batch->size = batch->enc->strip(batch->out, batch->pixels, WIDTH, batch->rows);
+	else
+		render_region(&batch->trace, item, scratch);
+}
+
+/** Rows y0 ... y1-1 of the k-th strip in the encoder's file order **/
+static void strip_rows(const encoder *enc, int k, int *y0, int *y1) {
+
+	if(enc->bottom_up) {
+		*y1 = HEIGHT - k * STRIP_ROWS;
+		*y0 = (*y1 - STRIP_ROWS > 0) ? *y1 - STRIP_ROWS : 0;
+	}
+	else {
+		*y0 = k * STRIP_ROWS;
+		*y1 = (*y0 + STRIP_ROWS < HEIGHT) ? *y0 + STRIP_ROWS : HEIGHT;
+	}
+}
+
+static void *encoded_writer(void *arg) {
+
+	encode_state *st = (encode_state*) arg;
+
+	for(int k = 0; k < st->strips; k++) {
+
+		pthread_mutex_lock(&st->lock);
+		while(st->encoded <= k)
+			pthread_cond_wait(&st->changed, &st->lock);
+		pthread_mutex_unlock(&st->lock);
+
+		int slot = k % STREAM_RING;
+		int error = pwrite_all(st->fd, st->out[slot], st->size[slot], st->offset);
+		st->offset += st->size[slot];
+
+		pthread_mutex_lock(&st->lock);
+		if(error)
+			st->failed = 1;
+		st->written++;
+		pthread_cond_signal(&st->changed);
+		pthread_mutex_unlock(&st->lock);
+	}
+
+	return NULL;
+}
+
+int raytracer_encoded(const char* filename, const render_scene *scene, render_pool *pool, const encoder *enc, render_times *times) {
+
+	if(!g_quiet)
+		printf("%s (%i):  ", filename, pool->threads);
+	int success = EXIT_FAILURE;
+
+	// init time measurement. encoding is part of the trace batches, so its time shows up under trace
+	*times = (render_times) { 0 };
+	double mark = now_ns();
+
+	// one row per work item
+	partition rows;
+	partition_make(&rows, PARTITION_ROWS, WIDTH, HEIGHT, HEIGHT, 0, NULL);
+
+	encode_state st = { .strips = (HEIGHT + STRIP_ROWS - 1) / STRIP_ROWS };
+	int have_buffers = rows.regions != NULL;
+
+	for(int i = 0; i < STREAM_RING; i++) {
+		st.raw[i] = (unsigned char*) malloc((size_t) STRIP_ROWS * WIDTH * sizeof(pix_t));
+		st.out[i] = (unsigned char*) malloc(enc->bound(WIDTH, STRIP_ROWS));
+		have_buffers = have_buffers && st.raw[i] && st.out[i];
+	}
+
+	FILE *file = fopen(filename, "wb");
+
+	if(file && have_buffers) {
+
+		lap(&times->setup, &mark);
+
+		int error = enc->header(file, WIDTH, HEIGHT);
+		fflush(file);
+		st.offset = ftell(file);
+		st.fd = fileno(file);
+		lap(&times->encode, &mark);
+
+		pthread_mutex_init(&st.lock, NULL);
+		pthread_cond_init(&st.changed, NULL);
+
+		pthread_t writer;
+		if(!error && st.offset >= 0 && pthread_create(&writer, NULL, encoded_writer, &st) == 0) {
+
+			// batch k traces strip k and encodes strip k-1; one more batch at the end encodes the last strip
+			for(int k = 0; k <= st.strips; k++) {
+
+				encode_batch batch = { .enc = enc };
+				int traced = 0;
+
+				if(k > 0) {
+					// the encoded strip's output buffer must be back from the writer
+					pthread_mutex_lock(&st.lock);
+					while(k - 1 - st.written >= STREAM_RING)
+						pthread_cond_wait(&st.changed, &st.lock);
+					pthread_mutex_unlock(&st.lock);
+					lap(&times->write, &mark);
+
+					int y0, y1;
+					strip_rows(enc, k - 1, &y0, &y1);
+					batch.pixels = st.raw[(k - 1) % STREAM_RING];
+					batch.rows = y1 - y0;
+					batch.out = st.out[(k - 1) % STREAM_RING];
+				}
+
+				if(k < st.strips) {
+					int y0, y1;
+					strip_rows(enc, k, &y0, &y1);
+
+					// raw strips are packed top-down, just as raytrace writes them and the encoders read them
+					batch.trace = (render_job) { scene, rows.regions + y0, st.raw[k % STREAM_RING], WIDTH * sizeof(pix_t), y0, NULL };
+					traced = y1 - y0;
+				}
+
+				render_pool_run(pool, traced + (batch.pixels != NULL), trace_or_encode, &batch);
+				lap(&times->trace, &mark);
+
+				if(k > 0) {
+					pthread_mutex_lock(&st.lock);
+					st.size[(k - 1) % STREAM_RING] = batch.size;
+					st.encoded++;
+					pthread_cond_signal(&st.changed);
+					pthread_mutex_unlock(&st.lock);
+				}
+			}
+
+			pthread_join(writer, NULL);
+			success = st.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+		}
+
+		pthread_cond_destroy(&st.changed);
+		pthread_mutex_destroy(&st.lock);
+
+		fclose(file);
+		file = NULL;
+		lap(&times->write, &mark);
+	}
+
+	else {
+		printf("Error opening file or allocating memory.\n");
+	}
+
+	if(file)
+		fclose(file);
+	for(int i = 0; i < STREAM_RING; i++) {
+		free(st.raw[i]);
+		free(st.out[i]);
+	}
+	partition_free(&rows);
+
+	print_render_time(times);
+
+	return success;
+}
+
+/*******PROGRESSIVE WRITE: a coarse preview first, then refine only where the picture has detail********/
+//the first pass traces one pixel per PROGRESSIVE_STEP x PROGRESSIVE_STEP block and fills the block with it. every pass
+//after that halves the block size, but only inside blocks whose corner sample differs from the corner samples of the
+//blocks to its right and below by more than the threshold; flat blocks keep their colour and get no more rays. the
+//picture is traced into the mapped .bmp and synced after each pass, so the file always holds the latest preview.
+//a negative threshold refines everywhere, and the last pass then leaves exactly the picture every other mode writes.
+
+#define PROGRESSIVE_STEP 8		//block size of the first pass; a power of two
+#define PROGRESSIVE_THRESHOLD 8		//largest per-byte colour difference still counted as flat
+
+typedef struct
+{
+	render_job target;		//scene and where the pixels go
+	unsigned char *active;		//active[y * WIDTH + x]: the block with its corner at (x, y) is still being refined
+	int step;			//block size of the current pass
+	int threshold;
+	atomic_long rays;		//pixels traced so far
+} progressive_job;
+
+static pix_t *pixel_at(const render_job *job, int x, int y) {
+
+	return (pix_t*) (job->base + (long) (y - job->first_row) * job->row_bytes) + x;
+}
+
+static int pixels_differ(const pix_t *a, const pix_t *b, int threshold) {
+
+	const unsigned char *p = (const unsigned char*) a;
+	const unsigned char *q = (const unsigned char*) b;
+
+	for(size_t i = 0; i < sizeof(pix_t); i++) {
+		if(abs(p[i] - q[i]) > threshold)
+			return 1;
+	}
+	return threshold < 0;
+}
+
+/** Trace the pixel at (x, y) and paint the size x size block it's the corner of with it, cut off at the picture's edges **/
+static void trace_block(progressive_job *job, int x, int y, int size) {
+
+	const render_scene *rs = job->target.scene;
+	pix_t *corner = pixel_at(&job->target, x, y);
+
+	raytrace(corner, (vec_t*) rs->bounds, rs->scene, x, y, 1, 1);
+
+	int w = (WIDTH - x < size) ? WIDTH - x : size;
+	int h = (HEIGHT - y < size) ? HEIGHT - y : size;
+
+	for(int row = 0; row < h; row++) {
+		pix_t *line = pixel_at(&job->target, x, y + row);
+		for(int col = 0; col < w; col++)
+			line[col] = *corner;
+	}
+}
+
+/** Work item for the first pass: one row of blocks **/
+static void coarse_row(void *ctx, int item, pix_t *scratch) {
+
+	progressive_job *job = (progressive_job*) ctx;
+	int y = item * job->step;
+	long rays = 0;
+	(void) scratch;
+
+	for(int x = 0; x < WIDTH; x += job->step) {
+		trace_block(job, x, y, job->step);
+		job->active[y * WIDTH + x] = 1;
+		rays++;
+	}
+
+	atomic_fetch_add(&job->rays, rays);
+}
+
+/** Work item for the later passes: split the row of blocks' busy blocks in four. only pixels inside the row's own blocks **/
+/** are written, and block corners aren't written at all, so reading the corners of the row below is safe **/
+static void refine_row(void *ctx, int item, pix_t *scratch) {
+
+	progressive_job *job = (progressive_job*) ctx;
+	int s = job->step, half = s / 2;
+	int y = item * s;
+	long rays = 0;
+	(void) scratch;
+
+	for(int x = 0; x < WIDTH; x += s) {
+
+		if(!job->active[y * WIDTH + x])
+			continue;
+
+		// compare the corner with its neighbours' corners
+		pix_t *corner = pixel_at(&job->target, x, y);
+		int busy = 0;
+
+		if(x + s < WIDTH)
+			busy |= pixels_differ(corner, pixel_at(&job->target, x + s, y), job->threshold);
+		if(y + s < HEIGHT)
+			busy |= pixels_differ(corner, pixel_at(&job->target, x, y + s), job->threshold);
+		if(x + s < WIDTH && y + s < HEIGHT)
+			busy |= pixels_differ(corner, pixel_at(&job->target, x + s, y + s), job->threshold);
+		if(x + s >= WIDTH && y + s >= HEIGHT)
+			busy = 1;		//nothing to compare with in the bottom right corner: play it safe
+
+		if(!busy) {
+			job->active[y * WIDTH + x] = 0;		//flat: this block is done for good
+			continue;
+		}
+
+		// the top left quarter keeps the corner's colour; the other three get a sample of their own
+		for(int q = 1; q < 4; q++) {
+			int qx = x + (q & 1) * half;
+			int qy = y + (q >> 1) * half;
+
+			if(qx < WIDTH && qy < HEIGHT) {
+				trace_block(job, qx, qy, half);
+				job->active[qy * WIDTH + qx] = 1;
+				rays++;
+			}
+		}
+	}
+
+	atomic_fetch_add(&job->rays, rays);
+}
+
+int raytracer_progressive(const char* filename, const render_scene *scene, render_pool *pool, int threshold, render_times *times) {
+
+	if(!g_quiet)
+		printf("%s (%i):  ", filename, pool->threads);
+	int success = EXIT_FAILURE;
+	double first_pass = 0;
+
+	// init time measurement
+	*times = (render_times) { 0 };
+	double start = now_ns(), mark = start;
+
+	progressive_job job = { .target = { scene, NULL, NULL, 0, 0, NULL }, .threshold = threshold };
+	job.active = (unsigned char*) calloc(HEIGHT, WIDTH);
+	atomic_init(&job.rays, 0);
+
+	FILE *file = fopen(filename, "wb+");
+
+	if(file && job.active) {
+
+		lap(&times->setup, &mark);
+
+		// write the header, and map the whole file, as for the mapped write
+		write_bitmap_header(file, WIDTH, HEIGHT);
+		fflush(file);
+		long header_size = ftell(file);
+
+		size_t file_size = header_size + (size_t) HEIGHT * BMP_ROW_BYTES;
+		unsigned char *map = MAP_FAILED;
+		if(header_size >= 0 && ftruncate(fileno(file), file_size) == 0)
+			map = (unsigned char*) mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(file), 0);
+		lap(&times->encode, &mark);
+
+		if(map != MAP_FAILED) {
+
+			bmp_target(&job.target, map + header_size, 0, HEIGHT);
+
+			// the coarse pass with blocks of PROGRESSIVE_STEP, then one pass splitting blocks of each size down to 2 into four
+			for(int s = PROGRESSIVE_STEP; s >= 1; s /= 2) {
+
+				job.step = (s == PROGRESSIVE_STEP) ? s : 2 * s;
+				render_pool_run(pool, (HEIGHT + job.step - 1) / job.step, (s == PROGRESSIVE_STEP) ? coarse_row : refine_row, &job);
+				lap(&times->trace, &mark);
+
+				// push this pass out to the file before starting on the next
+				msync(map, file_size, MS_SYNC);
+				lap(&times->write, &mark);
+
+				if(first_pass == 0)
+					first_pass = mark - start;
+			}
+
+			munmap(map, file_size);
+			success = EXIT_SUCCESS;
+		}
+
+		else {
+			perror("Error mapping output file");
+		}
+
+		fclose(file);
+		lap(&times->write, &mark);
+	}
+
+	else {
+		printf("Error opening file or allocating memory.\n");
+		if(file)
+			fclose(file);
+	}
+
+	free(job.active);
+	times->rays = atomic_load(&job.rays);
+
+	if(!g_quiet && success == EXIT_SUCCESS)
+		printf("first pass after %.3fs, %ld of %ld rays  ", first_pass / 1e9, (long) atomic_load(&job.rays), (long) WIDTH * HEIGHT);
+	print_render_time(times);
+
+	return success;
+}
+
+/*******BENCHMARK: every mode, warmed up and then timed over and over, at 1, 2, 4, ... up to PROCESSCOUNT workers********/
+//prints one CSV line per mode, worker count and phase: the median and 95th percentile over the timed runs, and the speedup
+//and efficiency of the median against the same mode on a single worker. the pool is started before a mode is timed, so
+//thread start-up is not part of any phase. the trace and total lines also give throughput in million primary rays per
+//second (one per pixel, or as many as were actually traced for progressive), the number a faster raytrace kernel has to move.
+
+#define BENCH_PHASES 5
+#define BENCH_FILE "image-bench.bmp"
+#define BENCH_RAYS ((double) WIDTH * HEIGHT)	//primary rays per render
+
+static const char *PHASE[BENCH_PHASES] = { "setup", "trace", "encode", "write", "total" };
+
+typedef int (*bench_fn)(const char *filename, const render_scene *scene, render_pool *pool, render_times *times);
+
+static int bench_simple(const char *filename, const render_scene *scene, render_pool *pool, render_times *times) {
+	(void) pool;
+	return raytracer_simple(filename, scene, times);
+}
+
+//the loop renders its strips one after the other on the calling thread; pool->threads only sets how many strips
+static int bench_loop(const char *filename, const render_scene *scene, render_pool *pool, render_times *times) {
+	return raytracer_loop(filename, scene, pool->threads, times);
+}
+
+static int bench_rows(const char *filename, const render_scene *scene, render_pool *pool, render_times *times) {
+	return raytracer_parallel(filename, scene, pool, PARTITION_ROWS, times);
+}
+
+static int bench_tiles(const char *filename, const render_scene *scene, render_pool *pool, render_times *times) {
+	return raytracer_parallel(filename, scene, pool, PARTITION_TILES, times);
+}
+
+static int bench_morton(const char *filename, const render_scene *scene, render_pool *pool, render_times *times) {
+	return raytracer_parallel(filename, scene, pool, PARTITION_MORTON, times);
+}
+
+static int bench_interleaved(const char *filename, const render_scene *scene, render_pool *pool, render_times *times) {
+	return raytracer_parallel(filename, scene, pool, PARTITION_INTERLEAVED, times);
+}
+
+static int bench_mmap(const char *filename, const render_scene *scene, render_pool *pool, render_times *times) {
+	return raytracer_mmap(filename, scene, pool, times);
+}
+
+static int bench_stream(const char *filename, const render_scene *scene, render_pool *pool, render_times *times) {
+	return raytracer_stream(filename, scene, pool, times);
+}
+
+static int bench_progressive(const char *filename, const render_scene *scene, render_pool *pool, render_times *times) {
+	return raytracer_progressive(filename, scene, pool, PROGRESSIVE_THRESHOLD, times);
+}
+
+static int bench_encoded_bmp(const char *filename, const render_scene *scene, render_pool *pool, render_times *times) {
+	return raytracer_encoded(filename, scene, pool, &ENCODER_BMP, times);
+}
+
+static int bench_encoded_ppm(const char *filename, const render_scene *scene, render_pool *pool, render_times *times) {
+	return raytracer_encoded(filename, scene, pool, &ENCODER_PPM, times);
+}
+
+static int bench_encoded_lz(const char *filename, const render_scene *scene, render_pool *pool, render_times *times) {
+	return raytracer_encoded(filename, scene, pool, &ENCODER_LZ, times);
+}
+
+static const struct
+{
+	const char *name;
+	bench_fn render;
+	int serial;		//only ever uses one thread, so it's only run once, with one worker; more would only look like poor scaling
+} STRATEGIES[] = {
+	{ "simple", bench_simple, 1 },
+	{ "loop", bench_loop, 1 },
+	{ "parallel-rows", bench_rows, 0 },
+	{ "parallel-tiles", bench_tiles, 0 },
+	{ "parallel-morton", bench_morton, 0 },
+	{ "parallel-interleaved", bench_interleaved, 0 },
+	{ "mmap", bench_mmap, 0 },
+	{ "stream", bench_stream, 0 },
+	{ "progressive", bench_progressive, 0 },
+	{ "encoded-bmp", bench_encoded_bmp, 0 },
+	{ "encoded-ppm", bench_encoded_ppm, 0 },
+	{ "encoded-lz", bench_encoded_lz, 0 },
+};
+
+#define NUM_STRATEGIES ((int) (sizeof(STRATEGIES) / sizeof(STRATEGIES[0])))
+
+static int compare_doubles(const void *a, const void *b) {
+
+	double x = *(const double*) a, y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int count, double p) {
+
+	return sorted[(int) (p * (count - 1) + 0.5)];
+}
+
+int benchmark(const render_scene *scene, int max_workers, int warmup, int runs) {
+
+	double *samples = (double*) malloc((size_t) BENCH_PHASES * runs * sizeof(double));	//samples[phase * runs + run]
+	double baseline[NUM_STRATEGIES][BENCH_PHASES] = { { 0 } };	//medians on one worker, to compute speedups against
+
+	if (!samples) {
+		printf("Could not allocate sample buffer.\n");
+		return EXIT_FAILURE;
+	}
+
+	g_quiet = 1;
+	printf("strategy,workers,phase,runs,median_ns,p95_ns,speedup,efficiency,mrays_per_sec\n");
+
+	// the renders share one scene, so building it is timed on its own
+	int built = 0;
+	for (int i = 0; i < warmup + runs; i++) {
+
+		double start = now_ns();
+		render_scene *rs = render_scene_new();
+		double end = now_ns();
+
+		if (!rs)
+			break;
+		render_scene_free(rs);
+
+		if (i >= warmup)
+			samples[built++] = end - start;
+	}
+
+	if (built == runs) {
+		qsort(samples, runs, sizeof(double), compare_doubles);
+		printf("scene,1,setup,%d,%.0f,%.0f,1.000,1.000,\n", runs, percentile(samples, runs, 0.50), percentile(samples, runs, 0.95));
+	}
+
+	// 1, 2, 4, ... workers, and PROCESSCOUNT itself if it isn't a power of two
+	for (int workers = 1; workers <= max_workers; workers = (workers * 2 > max_workers && workers < max_workers) ? max_workers : workers * 2) {
+
+		render_pool *pool = render_pool_new(workers);
+		if (!pool || pool->threads != workers) {
+			printf("Could not start %d render threads.\n", workers);
+			if (pool)
+				render_pool_free(pool);
+			break;
+		}
+
+		for (int s = 0; s < NUM_STRATEGIES; s++) {
+
+			if (STRATEGIES[s].serial && workers > 1)
+				continue;
+
+			render_times times;
+			int failed = 0;
+			double rays = BENCH_RAYS;
+
+			for (int i = 0; i < warmup && !failed; i++)
+				failed = STRATEGIES[s].render(BENCH_FILE, scene, pool, &times) != EXIT_SUCCESS;
+
+			for (int i = 0; i < runs && !failed; i++) {
+				failed = STRATEGIES[s].render(BENCH_FILE, scene, pool, &times) != EXIT_SUCCESS;
+
+				double phase[BENCH_PHASES] = { times.setup, times.trace, times.encode, times.write, render_total(&times) };
+				for (int p = 0; p < BENCH_PHASES; p++)
+					samples[p * runs + i] = phase[p];
+
+				// the scene doesn't change between runs, so neither do the rays a mode traces
+				if (times.rays > 0)
+					rays = times.rays;
+			}
+
+			if (failed) {
+				printf("%s,%d,failed,,,,,,\n", STRATEGIES[s].name, workers);
+				continue;
+			}
+
+			for (int p = 0; p < BENCH_PHASES; p++) {
+
+				double *sorted = samples + p * runs;
+				qsort(sorted, runs, sizeof(double), compare_doubles);
+
+				double median = percentile(sorted, runs, 0.50);
+				double p95 = percentile(sorted, runs, 0.95);
+
+				if (workers == 1)
+					baseline[s][p] = median;
+
+				double speedup = median > 0 ? baseline[s][p] / median : 0;
+
+				printf("%s,%d,%s,%d,%.0f,%.0f,%.3f,%.3f,", STRATEGIES[s].name, workers, PHASE[p], runs,
+					median, p95, speedup, speedup / workers);
+
+				// rays per second only mean something for the phases that trace
+				if ((p == 1 || p == BENCH_PHASES - 1) && median > 0)
+					printf("%.3f\n", rays / median * 1e3);
+				else
+					printf("\n");
+			}
+		}
+
+		render_pool_free(pool);
+	}
+
+	remove(BENCH_FILE);
+	free(samples);
+	g_quiet = 0;
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+
+	// raytracer --bench PROCESSCOUNT [WARMUP [RUNS]]
+	if (argc >= 3 && argc <= 5 && strcmp(argv[1], "--bench") == 0) {
+
+		int max_workers = strtol(argv[2], NULL, 10);
+		int warmup = argc > 3 ? strtol(argv[3], NULL, 10) : 2;
+		int runs = argc > 4 ? strtol(argv[4], NULL, 10) : 10;
+
+		if (max_workers < 1 || warmup < 0 || runs < 1) {
+			printf("PROCESSCOUNT and RUNS must be at least 1, WARMUP at least 0.\n");
+			return EXIT_FAILURE;
+		}
+
+		render_scene *scene = render_scene_new();
+		if (!scene) {
+			printf("Could not create scene.\n");
+			return EXIT_FAILURE;
+		}
+
+		int result = benchmark(scene, max_workers, warmup, runs);
+		render_scene_free(scene);
+		return result;
+	}
+
+	if (argc != 2) {
+		printf("Usage: raytracer PROCESSCOUNT\n");
+		printf("       raytracer --bench PROCESSCOUNT [WARMUP [RUNS]]\n");
+		return EXIT_FAILURE;
+	}
+	
+	long count = strtol(argv[1], NULL, 10);
+
+	if (count < 1 || count > INT_MAX) {
+		printf("PROCESSCOUNT must be between 1 and %d.\n", INT_MAX);
+		return EXIT_FAILURE;
+	}
+
+	int processcount = (int)count;
+
+	// build the scene once; every render only reads it
+	render_scene *scene = render_scene_new();
+	if (!scene) {
+		printf("Could not create scene.\n");
+		return EXIT_FAILURE;
+	}
+
+	// start the render threads once; every parallel render reuses them
+	render_pool *pool = render_pool_new(processcount);
+	if (!pool) {
+		printf("Could not start %d render threads.\n", processcount);
+		render_scene_free(scene);
+		return EXIT_FAILURE;
+	}
+
+	render_times times;
+
+	if (raytracer_simple("image-simple.bmp", scene, &times) != EXIT_SUCCESS){
+		printf("Error or not implemented.\n\n");
+	}
+	
+	if (raytracer_loop("image-loop.bmp", scene, processcount, &times) != EXIT_SUCCESS){
+		printf("Error or not implemented.\n\n");
+	}
+
+	// every way of splitting up the picture produces the same file, some faster than others
+	partition_kind kinds[] = { PARTITION_ROWS, PARTITION_TILES, PARTITION_MORTON, PARTITION_INTERLEAVED };
+
+	for (int i = 0; i < 4; i++) {
+
+		char filename[64];
+		snprintf(filename, sizeof(filename), "image-parallel-%s.bmp", partition_name(kinds[i]));
+
+		if (raytracer_parallel(filename, scene, pool, kinds[i], &times) != EXIT_SUCCESS){
+			printf("Error or not implemented.\n\n");
+		}
+	}
+
+	if (raytracer_mmap("image-mmap.bmp", scene, pool, &times) != EXIT_SUCCESS){
+		printf("Error or not implemented.\n\n");
+	}
+
+	if (raytracer_stream("image-stream.bmp", scene, pool, &times) != EXIT_SUCCESS){
+		printf("Error or not implemented.\n\n");
+	}
+
+	if (raytracer_progressive("image-progressive.bmp", scene, pool, PROGRESSIVE_THRESHOLD, &times) != EXIT_SUCCESS){
+		printf("Error or not implemented.\n\n");
+	}
+
+	// the same picture through each encoder, encoded strip by strip while the next strip is traced
+	const encoder *encoders[] = { &ENCODER_BMP, &ENCODER_PPM, &ENCODER_LZ };
+
+	for (int i = 0; i < 3; i++) {
+
+		char filename[64];
+		snprintf(filename, sizeof(filename), "image-encoded.%s", encoders[i]->extension);
+
+		if (raytracer_encoded(filename, scene, pool, encoders[i], &times) != EXIT_SUCCESS){
+			printf("Error or not implemented.\n\n");
+		}
+	}
+
+	render_pool_free(pool);
+	render_scene_free(scene);
+
+	return 0;
+}
@@ -0,0 +1,212 @@
+#include "partition.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+				/** Picture Partitioner **/
+/** Strips, tiles, Z-ordered tiles and interleaved scanlines, all described the same way: a list of rectangles. **/
+/** Strips can be split by measured cost rather than by height, so the slow rows of a picture (reflections, lots of **/
+/** geometry) are spread over more strips and no worker is left with all of them. **/
+
+static const char *NAME[] = { "rows", "tiles", "morton", "interleaved" };
+
+const char *partition_name(partition_kind kind)
+{
+	return (kind >= PARTITION_ROWS && kind <= PARTITION_INTERLEAVED) ? NAME[kind] : "unknown";
+}
+
+/** Strips of equal height; the rows that don't divide evenly go one each to the first strips **/
+static void split_even(region *regions, int width, int height, int parts)
+{
+	for(int i = 0; i < parts; i++) {
+		int y0 = (int)((long)height * i / parts);
+		int y1 = (int)((long)height * (i + 1) / parts);
+		regions[i] = (region) { 0, y0, width, y1 - y0 };
+	}
+}
+
+/** Strips of equal cost: strip i ends where the running cost passes (i+1)/parts of the total **/
+static void split_by_cost(region *regions, int width, int height, int parts, const double *row_cost)
+{
+	double total = 0;
+	for(int y = 0; y < height; y++)
+		total += row_cost[y];
+
+	if(!(total > 0)) {
+		split_even(regions, width, height, parts);
+		return;
+	}
+
+	int y = 0;
+	double sum = 0;
+
+	for(int i = 0; i < parts; i++) {
+
+		int start = y;
+		double target = total * (i + 1) / parts;
+		int last_end = height - (parts - 1 - i);	//leave at least one row for each strip still to come
+
+		//every strip takes at least one row, then keeps taking rows as long as more than half of the next row fits
+		sum += row_cost[y++];
+		while(y < last_end && sum + row_cost[y] / 2 <= target)
+			sum += row_cost[y++];
+
+		if(i == parts - 1)
+			y = height;		//the last strip takes whatever is left
+
+		regions[i] = (region) { 0, start, width, y - start };
+	}
+}
+
+/** Spread the low 16 bits of v out to the even bits, so two of them interleave into a Z-order key **/
+static uint32_t spread_bits(uint32_t v)
+{
+	v &= 0xffff;
+	v = (v | (v << 8)) & 0x00ff00ff;
+	v = (v | (v << 4)) & 0x0f0f0f0f;
+	v = (v | (v << 2)) & 0x33333333;
+	v = (v | (v << 1)) & 0x55555555;
+	return v;
+}
+
+typedef struct
+{
+	uint32_t key;
+	region r;
+} keyed_region;
+
+static int compare_keys(const void *a, const void *b)
+{
+	uint32_t x = ((const keyed_region*)a)->key, y = ((const keyed_region*)b)->key;
+	return (x > y) - (x < y);
+}
+
+/** Tiles row by row, or in Z-order; the tiles at the right and bottom edges are cut to fit **/
+static int split_tiles(partition *part, int width, int height, int tile, int morton)
+{
+	int tiles_x = (width + tile - 1) / tile;
+
+	for(int i = 0; i < part->count; i++) {
+		int x = (i % tiles_x) * tile;
+		int y = (i / tiles_x) * tile;
+		part->regions[i] = (region) { x, y, (width - x < tile) ? width - x : tile, (height - y < tile) ? height - y : tile };
+	}
+
+	if(!morton)
+		return 0;
+
+	keyed_region *keyed = (keyed_region*)malloc(part->count * sizeof(keyed_region));
+	if(keyed == NULL)
+		return -1;
+
+	for(int i = 0; i < part->count; i++)
+		keyed[i] = (keyed_region) { spread_bits(i % tiles_x) | spread_bits(i / tiles_x) << 1, part->regions[i] };
+
+	qsort(keyed, part->count, sizeof(keyed_region), compare_keys);
+
+	for(int i = 0; i < part->count; i++)
+		part->regions[i] = keyed[i].r;
+
+	free(keyed);
+	return 0;
+}
+
+/** Single rows, grouped by the part they're dealt to: part 0's rows first, then part 1's, ... **/
+static void split_interleaved(region *regions, int width, int height, int parts)
+{
+	int i = 0;
+	for(int g = 0; g < parts; g++) {
+		for(int y = g; y < height; y += parts)
+			regions[i++] = (region) { 0, y, width, 1 };
+	}
+}
+
+int partition_make(partition *part, partition_kind kind, int width, int height, int parts, int tile, const double *row_cost)
+{
+	part->count = 0;
+	part->regions = NULL;
+
+	if(width < 1 || height < 1) {
+		printf("Cannot partition a %dx%d picture.\n", width, height);
+		return -1;
+	}
+
+	//more strips than rows would leave some of them empty
+	if(parts < 1)
+		parts = 1;
+	if(parts > height)
+		parts = height;
+
+	switch(kind) {
+		case PARTITION_ROWS:
+			part->count = parts;
+			break;
+		case PARTITION_TILES:
+		case PARTITION_MORTON:
+			if(tile < 1) {
+				printf("Tile size must be at least 1.\n");
+				return -1;
+			}
+			part->count = ((width + tile - 1) / tile) * ((height + tile - 1) / tile);
+			break;
+		case PARTITION_INTERLEAVED:
+			part->count = height;
+			break;
+		default:
+			printf("Unknown partition kind %d.\n", kind);
+			return -1;
+	}
+
+	part->regions = (region*)malloc(part->count * sizeof(region));
+	if(part->regions == NULL) {
+		printf("Could not allocate partition.\n");
+		part->count = 0;
+		return -1;
+	}
+
+	int error = 0;
+
+	switch(kind) {
+		case PARTITION_ROWS:
+			if(row_cost)
+				split_by_cost(part->regions, width, height, parts, row_cost);
+			else
+				split_even(part->regions, width, height, parts);
+			break;
+		case PARTITION_TILES:
+		case PARTITION_MORTON:
+			error = split_tiles(part, width, height, tile, kind == PARTITION_MORTON);
+			break;
+		case PARTITION_INTERLEAVED:
+			split_interleaved(part->regions, width, height, parts);
+			break;
+	}
+
+	if(error) {
+		printf("Could not allocate partition.\n");
+		partition_free(part);
+		return -1;
+	}
+
+	return 0;
+}
+
+void partition_free(partition *part)
+{
+	free(part->regions);
+	part->regions = NULL;
+	part->count = 0;
+}
+
+/** Each region's cost is shared evenly by its rows, and a row's cost is the sum over all regions it's part of **/
+void partition_row_cost(const partition *part, const double *region_cost, double *row_cost, int height)
+{
+	for(int y = 0; y < height; y++)
+		row_cost[y] = 0;
+
+	for(int i = 0; i < part->count; i++) {
+		region r = part->regions[i];
+		for(int y = r.y; y < r.y + r.h; y++)
+			row_cost[y] += region_cost[i] / r.h;
+	}
+}
@@ -0,0 +1,38 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+/** Splits a width x height picture into the regions a render hands out as work, in the order they're handed out **/
+/** Every pixel belongs to exactly one region, so any way of working through the regions produces the same picture; **/
+/** the kinds only differ in how well the work balances and how cache-friendly each piece is **/
+
+typedef enum
+{
+	PARTITION_ROWS,		//parts horizontal strips of whole rows, top to bottom
+	PARTITION_TILES,	//tile x tile squares, row by row
+	PARTITION_MORTON,	//the same tiles in Z-order, so consecutive tiles stay close together
+	PARTITION_INTERLEAVED	//single rows dealt out round-robin: part g gets rows g, g+parts, g+2*parts, ...
+} partition_kind;
+
+typedef struct
+{
+	int x, y;		//top left corner
+	int w, h;
+} region;
+
+typedef struct
+{
+	int count;
+	region *regions;
+} partition;
+
+/** row_cost (may be NULL) is the time each row took last time; rows are then split into strips of equal cost **/
+/** instead of equal height. parts is ignored by the tiled kinds, tile by the others. returns 0 on success, -1 otherwise **/
+int partition_make(partition *part, partition_kind kind, int width, int height, int parts, int tile, const double *row_cost);
+void partition_free(partition *part);
+
+/** Turn the time each region took (region_cost[i] for part->regions[i]) into the time each row took, for the next split **/
+void partition_row_cost(const partition *part, const double *region_cost, double *row_cost, int height);
+
+const char *partition_name(partition_kind kind);
+
+#endif
@@ -0,0 +1,216 @@
+#include "resvec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RESVEC_X86 1
+#endif
+
+				/** Resource Vector Kernels **/
+/** Three sets of the same kernels: plain C, SSE2 (4 counts at a time) and AVX2 (8 at a time). **/
+/** SSE2 has no unsigned compare, so both sides get their sign bit flipped and are compared signed; AVX2 compares **/
+/** a <= b as max(a, b) == b. Whatever doesn't fill a whole register is finished by the next narrower kernel. **/
+
+typedef struct
+{
+	const char *name;
+	int (*all_le)(const unsigned *a, const unsigned *b, int n);
+	void (*add)(unsigned *dst, const unsigned *src, int n);
+	int (*is_zero)(const unsigned *a, int n);
+} kernels;
+
+int resvec_padded(int n)
+{
+	return (n + RESVEC_LANES - 1) / RESVEC_LANES * RESVEC_LANES;
+}
+
+/** n counts, all 0, aligned and padded for the kernels; give back with free() **/
+unsigned* resvec_alloc(int n)
+{
+	size_t bytes = (size_t)resvec_padded(n > 0 ? n : 1) * sizeof(unsigned);
+
+	unsigned *v = (unsigned*)aligned_alloc(RESVEC_ALIGN, bytes);
+	if(v == NULL) {
+		printf("Could not allocate resource vector.\n");
+		return NULL;
+	}
+
+	memset(v, 0, bytes);
+	return v;
+}
+
+static int scalar_all_le(const unsigned *a, const unsigned *b, int n)
+{
+	for(int i = 0; i < n; i++) {
+		if(a[i] > b[i])
+			return 0;
+	}
+	return 1;
+}
+
+static void scalar_add(unsigned *dst, const unsigned *src, int n)
+{
+	for(int i = 0; i < n; i++)
+		dst[i] += src[i];
+}
+
+static int scalar_is_zero(const unsigned *a, int n)
+{
+	for(int i = 0; i < n; i++) {
+		if(a[i] != 0)
+			return 0;
+	}
+	return 1;
+}
+
+static const kernels SCALAR = { "scalar", scalar_all_le, scalar_add, scalar_is_zero };
+
+#ifdef RESVEC_X86
+
+static int sse2_all_le(const unsigned *a, const unsigned *b, int n)
+{
+	const __m128i bias = _mm_set1_epi32((int)0x80000000u);
+	int i = 0;
+
+	for(; i + 4 <= n; i += 4) {
+		__m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(a + i)), bias);
+		__m128i y = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(b + i)), bias);
+		if(_mm_movemask_epi8(_mm_cmpgt_epi32(x, y)))
+			return 0;
+	}
+
+	return scalar_all_le(a + i, b + i, n - i);
+}
+
+static void sse2_add(unsigned *dst, const unsigned *src, int n)
+{
+	int i = 0;
+
+	for(; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(dst + i));
+		__m128i y = _mm_loadu_si128((const __m128i*)(src + i));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi32(x, y));
+	}
+
+	scalar_add(dst + i, src + i, n - i);
+}
+
+static int sse2_is_zero(const unsigned *a, int n)
+{
+	int i = 0;
+
+	for(; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+		if(_mm_movemask_epi8(_mm_cmpeq_epi32(x, _mm_setzero_si128())) != 0xffff)
+			return 0;
+	}
+
+	return scalar_is_zero(a + i, n - i);
+}
+
+static const kernels SSE2 = { "sse2", sse2_all_le, sse2_add, sse2_is_zero };
+
+__attribute__((target("avx2")))
+static int avx2_all_le(const unsigned *a, const unsigned *b, int n)
+{
+	int i = 0;
+
+	for(; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+		if(_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_max_epu32(x, y), y)) != -1)
+			return 0;
+	}
+
+	return sse2_all_le(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void avx2_add(unsigned *dst, const unsigned *src, int n)
+{
+	int i = 0;
+
+	for(; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(dst + i));
+		__m256i y = _mm256_loadu_si256((const __m256i*)(src + i));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_add_epi32(x, y));
+	}
+
+	sse2_add(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static int avx2_is_zero(const unsigned *a, int n)
+{
+	int i = 0;
+
+	for(; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+		if(!_mm256_testz_si256(x, x))
+			return 0;
+	}
+
+	return sse2_is_zero(a + i, n - i);
+}
+
+static const kernels AVX2 = { "avx2", avx2_all_le, avx2_add, avx2_is_zero };
+
+#endif
+
+/** The widest kernels this CPU runs; RESVEC_KERNELS=scalar|sse2|avx2 in the environment picks narrower ones **/
+static const kernels* pick(void)
+{
+	const kernels *best = &SCALAR;
+
+#ifdef RESVEC_X86
+	__builtin_cpu_init();
+	best = __builtin_cpu_supports("avx2") ? &AVX2 : &SSE2;
+
+	const char *wanted = getenv("RESVEC_KERNELS");
+	if(wanted && strcmp(wanted, "scalar") == 0)
+		best = &SCALAR;
+	else if(wanted && strcmp(wanted, "sse2") == 0)
+		best = &SSE2;
+#endif
+
+	return best;
+}
+
+static const kernels* get(void)
+{
+	static _Atomic(const kernels*) chosen = NULL;
+
+	//every thread that gets here first picks the same set, so it doesn't matter who stores last
+	const kernels *k = atomic_load_explicit(&chosen, memory_order_acquire);
+	if(k == NULL) {
+		k = pick();
+		atomic_store_explicit(&chosen, k, memory_order_release);
+	}
+	return k;
+}
+
+/** 1 if a[i] <= b[i] for every i < n, 0 if not **/
+int resvec_all_le(const unsigned *a, const unsigned *b, int n)
+{
+	return get()->all_le(a, b, n);
+}
+
+/** dst[i] += src[i] for every i < n **/
+void resvec_add(unsigned *dst, const unsigned *src, int n)
+{
+	get()->add(dst, src, n);
+}
+
+/** 1 if a[i] == 0 for every i < n, 0 if not **/
+int resvec_is_zero(const unsigned *a, int n)
+{
+	return get()->is_zero(a, n);
+}
+
+const char* resvec_kernels(void)
+{
+	return get()->name;
+}
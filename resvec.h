@@ -0,0 +1,21 @@
+#ifndef RESVEC_H
+#define RESVEC_H
+
+/** Kernels for vectors of resource counts: "does every need fit into what's free", "give these back", "is nothing held" **/
+/** They take any length and any alignment, but run fastest on vectors from resvec_alloc: aligned to RESVEC_ALIGN **/
+/** and zero-padded to a multiple of RESVEC_LANES, so there is no odd tail to finish one element at a time. **/
+/** The widest kernels the CPU supports are picked on first use (AVX2, SSE2, or plain C). **/
+
+#define RESVEC_ALIGN 32
+#define RESVEC_LANES (RESVEC_ALIGN / (int)sizeof(unsigned))
+
+int resvec_padded(int n);
+unsigned* resvec_alloc(int n);
+
+int resvec_all_le(const unsigned *a, const unsigned *b, int n);
+void resvec_add(unsigned *dst, const unsigned *src, int n);
+int resvec_is_zero(const unsigned *a, int n);
+
+const char* resvec_kernels(void);
+
+#endif
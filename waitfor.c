@@ -0,0 +1,152 @@
+#include "waitfor.h"
+#include "resvec.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+				/** Incremental Deadlock Detection **/
+/** Every cycle in the wait-for graph is made of blocked threads only (a running thread waits for nobody), so the **/
+/** thread that blocks last is the one that closes it. Checking the thread that just blocked is therefore enough, **/
+/** and nothing has to be polled. **/
+/** With several units per resource a cycle doesn't have to be a deadlock: a holder outside the cycle may finish **/
+/** and free enough. So a cycle is only the cheap first test, and a reduction over the blocked requests decides. **/
+
+struct waitfor
+{
+	int threads;
+	int resources;
+	int *waiting_on;	//the resource each thread is blocked on, -1 while it runs
+	unsigned *units;	//how many units of it the thread asked for
+
+	//scratch space for the checks
+	int *seen;		//threads already reached from the one that blocked
+	int *stack;		//threads still to visit
+	unsigned *work;		//what would be free after the threads finished so far
+};
+
+waitfor* waitfor_new(int threads, int resources)
+{
+	if(threads < 1 || resources < 1) {
+		printf("Need at least one thread and one resource.\n");
+		return NULL;
+	}
+
+	waitfor *w = (waitfor*)calloc(1, sizeof(waitfor));
+	if(w == NULL)
+		return NULL;
+
+	w->threads = threads;
+	w->resources = resources;
+	w->waiting_on = (int*)malloc(threads * sizeof(int));
+	w->units = (unsigned*)calloc(threads, sizeof(unsigned));
+	w->seen = (int*)malloc(threads * sizeof(int));
+	w->stack = (int*)malloc(threads * sizeof(int));
+	w->work = resvec_alloc(resources);
+
+	if(!w->waiting_on || !w->units || !w->seen || !w->stack || !w->work) {
+		waitfor_free(w);
+		return NULL;
+	}
+
+	for(int t = 0; t < threads; t++)
+		w->waiting_on[t] = -1;
+
+	return w;
+}
+
+void waitfor_free(waitfor *w)
+{
+	if(w == NULL)
+		return;
+
+	free(w->waiting_on);
+	free(w->units);
+	free(w->seen);
+	free(w->stack);
+	free(w->work);
+	free(w);
+}
+
+/** t waits for units of r from now on: its edges go to everyone holding r **/
+void waitfor_block(waitfor *w, int t, int r, unsigned units)
+{
+	w->waiting_on[t] = r;
+	w->units[t] = units;
+}
+
+/** t got what it asked for and runs again: its edges are gone **/
+void waitfor_unblock(waitfor *w, int t)
+{
+	w->waiting_on[t] = -1;
+	w->units[t] = 0;
+}
+
+/** Can t be reached again by following wait-for edges out of it? **/
+static int on_cycle(waitfor *w, const banker *b, int t)
+{
+	int top = 0;
+
+	for(int u = 0; u < w->threads; u++)
+		w->seen[u] = 0;
+
+	w->seen[t] = 1;
+	w->stack[top++] = t;
+
+	while(top > 0) {
+
+		int u = w->stack[--top];
+		int r = w->waiting_on[u];
+
+		for(int v = 0; v < w->threads; v++) {
+			if(v == u || banker_allocated(b, v, r) == 0)
+				continue;
+			if(v == t)
+				return 1;
+			//only blocked threads have edges of their own
+			if(!w->seen[v] && w->waiting_on[v] >= 0) {
+				w->seen[v] = 1;
+				w->stack[top++] = v;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/** Give back everything t holds, as if it had finished **/
+static void give_back(waitfor *w, const banker *b, int t)
+{
+	resvec_add(w->work, banker_allocated_row(b, t), w->resources);
+}
+
+/** Is blocked thread t deadlocked, i.e. can it not get what it waits for even if every thread that can finish does? **/
+/** returns 1 if so, 0 if not or if t isn't blocked **/
+int waitfor_is_deadlocked(waitfor *w, const banker *b, int t)
+{
+	if(w->waiting_on[t] < 0 || !on_cycle(w, b, t))
+		return 0;
+
+	//running threads finish and free what they hold; seen marks the finished threads from here on
+	for(int r = 0; r < w->resources; r++)
+		w->work[r] = banker_available(b, r);
+
+	for(int u = 0; u < w->threads; u++) {
+		w->seen[u] = w->waiting_on[u] < 0;
+		if(w->seen[u])
+			give_back(w, b, u);
+	}
+
+	//then every blocked thread whose request fits, until no more do
+	int progress = 1;
+	while(progress && !w->seen[t]) {
+		progress = 0;
+		for(int u = 0; u < w->threads; u++) {
+			if(w->seen[u] || w->units[u] > w->work[w->waiting_on[u]])
+				continue;
+			w->seen[u] = 1;
+			give_back(w, b, u);
+			progress = 1;
+		}
+	}
+
+	return !w->seen[t];
+}
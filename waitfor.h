@@ -0,0 +1,20 @@
+#ifndef WAITFOR_H
+#define WAITFOR_H
+
+#include "banker.h"
+
+/** Wait-for graph between blocked threads, kept up to date as threads block and resume **/
+/** A thread blocked on resource r waits for every other thread that holds units of r. The edges follow from what **/
+/** each blocked thread asked for and what the banker says is held, so blocking and resuming is all that has to be told. **/
+
+typedef struct waitfor waitfor;
+
+waitfor* waitfor_new(int threads, int resources);
+void waitfor_free(waitfor *w);
+
+void waitfor_block(waitfor *w, int t, int r, unsigned units);
+void waitfor_unblock(waitfor *w, int t);
+
+int waitfor_is_deadlocked(waitfor *w, const banker *b, int t);
+
+#endif
@@ -0,0 +1,125 @@
+#include "waitline.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+				/** Waiter Line **/
+/** A singly linked list threaded through per-thread arrays: a thread waits for one request at a time, so it is in **/
+/** the line at most once, and lining up or leaving never allocates. **/
+/** Serving walks the line oldest first and grants every request that can go, not just the first one: a request **/
+/** further back may well fit where the oldest doesn't (another resource, fewer units), and holding it up would **/
+/** free nothing for the oldest. A newcomer, though, always lines up behind a non-empty line, so any units handed **/
+/** out by the next serve go to the threads that asked before it first. **/
+
+struct waitline
+{
+	int threads;
+	int first, last;	//oldest and newest waiter, -1 if nobody is waiting
+	int *next;		//next[t]: the waiter after t, -1 for the newest
+	int *waiting;		//waiting[t]: is t in the line?
+	int *r;			//what each waiter asked for
+	unsigned *units;
+};
+
+waitline* waitline_new(int threads)
+{
+	if(threads < 1) {
+		printf("Need at least one thread.\n");
+		return NULL;
+	}
+
+	waitline *l = (waitline*)calloc(1, sizeof(waitline));
+	if(l == NULL)
+		return NULL;
+
+	l->threads = threads;
+	l->first = l->last = -1;
+	l->next = (int*)malloc(threads * sizeof(int));
+	l->waiting = (int*)calloc(threads, sizeof(int));
+	l->r = (int*)calloc(threads, sizeof(int));
+	l->units = (unsigned*)calloc(threads, sizeof(unsigned));
+
+	if(!l->next || !l->waiting || !l->r || !l->units) {
+		waitline_free(l);
+		return NULL;
+	}
+
+	return l;
+}
+
+void waitline_free(waitline *l)
+{
+	if(l == NULL)
+		return;
+
+	free(l->next);
+	free(l->waiting);
+	free(l->r);
+	free(l->units);
+	free(l);
+}
+
+/** Put t at the back of the line **/
+static void line_up(waitline *l, int t, int r, unsigned units)
+{
+	l->r[t] = r;
+	l->units[t] = units;
+	l->next[t] = -1;
+	l->waiting[t] = 1;
+
+	if(l->last < 0)
+		l->first = t;
+	else
+		l->next[l->last] = t;
+	l->last = t;
+}
+
+/** Take t, which comes right after previous (-1 if t is the oldest), out of the line **/
+static void leave(waitline *l, int previous, int t)
+{
+	if(previous < 0)
+		l->first = l->next[t];
+	else
+		l->next[previous] = l->next[t];
+	if(l->last == t)
+		l->last = previous;
+
+	l->waiting[t] = 0;
+}
+
+/** A new request: try it right away if nobody is waiting, otherwise line up behind the others **/
+/** returns 1 if it was granted, 0 if t is in the line now; it leaves only when waitline_serve grants it **/
+int waitline_admit(waitline *l, int t, int r, unsigned units, waitline_try try_grant, void *context)
+{
+	if(l->first < 0 && try_grant(context, t, r, units))
+		return 1;
+
+	line_up(l, t, r, units);
+	return 0;
+}
+
+/** Oldest first, grant every waiter whose request can go now, and take it out of the line **/
+void waitline_serve(waitline *l, waitline_try try_grant, waitline_granted granted, void *context)
+{
+	int previous = -1;
+	int t = l->first;
+
+	while(t >= 0) {
+		int next = l->next[t];
+
+		if(!try_grant(context, t, l->r[t], l->units[t])) {
+			previous = t;
+			t = next;
+			continue;
+		}
+
+		leave(l, previous, t);
+		granted(context, t, l->r[t], l->units[t]);
+
+		t = next;
+	}
+}
+
+int waitline_waiting(const waitline *l, int t)
+{
+	return l->waiting[t];
+}
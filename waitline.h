@@ -0,0 +1,22 @@
+#ifndef WAITLINE_H
+#define WAITLINE_H
+
+/** First come, first served line of threads whose request for units of a resource couldn't be granted **/
+/** A new request only gets a go of its own while nobody is waiting; otherwise it lines up, and the line is served **/
+/** oldest first, so a newcomer never takes units from under a thread that asked before it. **/
+/** Whether a request can go is up to the caller's try_grant, which also does the granting. **/
+
+typedef struct waitline waitline;
+
+typedef int (*waitline_try)(void *context, int t, int r, unsigned units);		//1 if granted, 0 if not
+typedef void (*waitline_granted)(void *context, int t, int r, unsigned units);	//t was granted and has left the line
+
+waitline* waitline_new(int threads);
+void waitline_free(waitline *l);
+
+int waitline_admit(waitline *l, int t, int r, unsigned units, waitline_try try_grant, void *context);
+void waitline_serve(waitline *l, waitline_try try_grant, waitline_granted granted, void *context);
+
+int waitline_waiting(const waitline *l, int t);
+
+#endif
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "waitline.h"
+
+				/** Tests for the waiter line **/
+/** Requests are granted or not by a table instead of a banker, and every call to try_grant and granted is recorded, **/
+/** so each test can check who got asked, who got through, and in which order. Exits with 1 if any check failed. **/
+
+#define THREADS 4
+
+typedef struct
+{
+	int can_go[THREADS];		//would a request by t be granted right now?
+	int asked[THREADS];		//how often try_grant was called for t
+	int order[THREADS];		//the threads granted by waitline_serve, in order
+	int granted;
+} table;
+
+static int failures = 0;
+
+static void check(int ok, const char *what)
+{
+	if(!ok) {
+		printf("FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+static int try_grant(void *context, int t, int r, unsigned units)
+{
+	table *tb = (table*)context;
+	tb->asked[t]++;
+	return tb->can_go[t];
+}
+
+static void granted(void *context, int t, int r, unsigned units)
+{
+	table *tb = (table*)context;
+	tb->order[tb->granted++] = t;
+}
+
+/** Nobody is waiting: a request that can go does, and never lines up **/
+static void test_empty_line(void)
+{
+	table tb = { { 1, 1, 1, 1 } };
+	waitline *l = waitline_new(THREADS);
+
+	check(waitline_admit(l, 0, 0, 1, try_grant, &tb) == 1, "a request that can go is granted while nobody waits");
+	check(!waitline_waiting(l, 0), "a granted request isn't in the line");
+
+	waitline_free(l);
+}
+
+/** A waiter that still can't go keeps the newcomer behind it, even though the newcomer's request could go **/
+static void test_no_barging(void)
+{
+	table tb = { { 0, 1, 1, 1 } };
+	waitline *l = waitline_new(THREADS);
+
+	check(waitline_admit(l, 0, 0, 3, try_grant, &tb) == 0, "a request that can't go lines up");
+
+	check(waitline_admit(l, 1, 1, 1, try_grant, &tb) == 0, "a newcomer lines up behind a waiter");
+	check(tb.asked[1] == 0, "a newcomer isn't tried while someone waits");
+	check(waitline_waiting(l, 0) && waitline_waiting(l, 1), "both are in the line");
+
+	//a release: the oldest still can't go, the newcomer can
+	waitline_serve(l, try_grant, granted, &tb);
+	check(tb.granted == 1 && tb.order[0] == 1, "serving grants the newcomer once it is in line");
+	check(waitline_waiting(l, 0) && !waitline_waiting(l, 1), "the oldest stays in the line");
+
+	waitline_free(l);
+}
+
+/** Serving asks the oldest first, and grants everyone who can go, not just up to the first who can't **/
+static void test_serve_order(void)
+{
+	table tb = { { 0, 0, 0, 0 } };
+	waitline *l = waitline_new(THREADS);
+
+	waitline_admit(l, 2, 0, 1, try_grant, &tb);
+	waitline_admit(l, 0, 0, 1, try_grant, &tb);
+	waitline_admit(l, 3, 0, 1, try_grant, &tb);
+	waitline_admit(l, 1, 0, 1, try_grant, &tb);
+
+	tb.can_go[2] = tb.can_go[3] = tb.can_go[1] = 1;
+	waitline_serve(l, try_grant, granted, &tb);
+
+	check(tb.granted == 3 && tb.order[0] == 2 && tb.order[1] == 3 && tb.order[2] == 1, "waiters are granted oldest first");
+	check(waitline_waiting(l, 0), "a waiter that can't go stays");
+
+	//the line is still in order after taking waiters out of the middle and the end
+	waitline_admit(l, 2, 0, 1, try_grant, &tb);
+	tb.can_go[0] = 1;
+	tb.granted = 0;
+	waitline_serve(l, try_grant, granted, &tb);
+
+	check(tb.granted == 2 && tb.order[0] == 0 && tb.order[1] == 2, "a waiter that lined up again is behind the older one");
+	check(!waitline_waiting(l, 0) && !waitline_waiting(l, 2), "the line is empty");
+	check(waitline_admit(l, 3, 0, 1, try_grant, &tb) == 1, "once the line is empty, requests go right away again");
+
+	waitline_free(l);
+}
+
+int main(void)
+{
+	test_empty_line();
+	test_no_barging();
+	test_serve_order();
+
+	if(failures > 0) {
+		printf("%d check(s) failed.\n", failures);
+		return 1;
+	}
+
+	printf("All waitline tests passed.\n");
+	return 0;
+}